@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <cstring>
+#include <time.h>
+
+#include "coroutine.h"
+
+/*
+ Context switch microbenchmark: nanoseconds per Resume()/Yield() round trip
+ for every coroutine backend, with and without saving the FP control state
+ where the backend can skip it (fcontext only before boost 1.61).
+
+ usage: bench_switch [round_trips]
+*/
+
+template <class Switch>
+struct Bench
+{
+    typedef COROUTINE<int, Bench *, Switch> Cor;
+
+    static int body( Bench *b )
+    {
+	for(;;)
+	    b->m_cor.Yield();
+	return 0;
+    }
+
+    double run( bool fpu, int n )
+    {
+	struct timespec t0, t1;
+
+	m_cor = Cor(body);
+	m_cor.SetPreserveFPU(fpu);
+	m_cor.Call(this);
+
+	// warm up caches and the branch predictor
+	for(int i = 0; i < n / 10; i++)
+	    m_cor.Resume();
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for(int i = 0; i < n; i++)
+	    m_cor.Resume();
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	return ( (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec) ) / n;
+    }
+
+    Cor m_cor;
+};
+
+template <class Switch>
+void report( const char *name, bool fpu, int n )
+{
+    Bench<Switch> b;
+
+    printf("%-12s fpu %-3s %8.2f ns\n", name, fpu ? "on" : "off", b.run(fpu, n));
+}
+
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 10000000;
+
+    printf("%d round trips per backend\n", n);
+
+    report<FcontextSwitch>("fcontext", true, n);
+#if BOOST_VERSION < 106100
+    report<FcontextSwitch>("fcontext", false, n);
+#endif
+    report<UcontextSwitch>("ucontext", true, n / 10);
+#ifdef COROUTINE_HAVE_ASM_SWITCH
+    report<AsmSwitch>("asm", true, n);
+    report<AsmSwitch>("asm", false, n);
+#endif
+
+    return 0;
+}
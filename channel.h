@@ -0,0 +1,207 @@
+#ifndef __CHANNEL_H
+#define __CHANNEL_H
+
+#include <deque>
+#include <utility>
+
+#include "sim.h"
+
+/*
+ Transaction-level channels between processes.
+
+ Fifo<T> (bounded), Mailbox<T> (unbounded) and Semaphore block the calling
+ process by suspending its coroutine and wake the other side directly with
+ Simulation::wake(): no signals, no commits, a woken process runs in the
+ same delta. Payloads are moved in and out, so a packet held in a
+ std::vector or similar is never copied on the way: put(c, std::move(p))
+ moves it in, put(c, p) leaves p alone and stores a copy.
+
+ The blocking calls can only be used from coroutine processes. Clocked and
+ combinational processes (which must not wait) use try_put()/try_get().
+*/
+
+// FIFO queue of waiting processes, woken one at a time
+class WaitQueue
+{
+public:
+    void wait( Context *c )
+    {
+	m_waiters.push_back(c);
+	c->suspend();
+    }
+
+    void wake_one()
+    {
+	if(m_waiters.empty())
+	    return;
+
+	Context *c = m_waiters.front();
+	m_waiters.pop_front();
+	c->m_sim->wake(c);
+    }
+
+    bool empty() const
+    {
+	return m_waiters.empty();
+    }
+
+private:
+    std::deque<Context *> m_waiters;
+};
+
+
+template <class T>
+class Fifo
+{
+public:
+    // depth 0: unbounded
+    Fifo( size_t depth ) : m_depth( depth ) {}
+
+    size_t size() const
+    {
+	return m_items.size();
+    }
+
+    bool empty() const
+    {
+	return m_items.empty();
+    }
+
+    bool full() const
+    {
+	return m_depth && m_items.size() >= m_depth;
+    }
+
+    // moves item into the FIFO, blocking while it is full
+    void put( Context *c, T&& item )
+    {
+	while(full())
+	    m_putters.wait(c);
+
+	m_items.push_back( std::move(item) );
+	m_getters.wake_one();
+    }
+
+    void put( Context *c, const T& item )
+    {
+	while(full())
+	    m_putters.wait(c);
+
+	m_items.push_back( item );
+	m_getters.wake_one();
+    }
+
+    // removes the oldest item, blocking while the FIFO is empty
+    T get( Context *c )
+    {
+	while(empty())
+	    m_getters.wait(c);
+
+	T item( std::move(m_items.front()) );
+	m_items.pop_front();
+	m_putters.wake_one();
+	return item;
+    }
+
+    // oldest item without removing it, blocking while the FIFO is empty
+    const T& peek( Context *c )
+    {
+	while(empty())
+	    m_getters.wait(c);
+
+	// let the next getter see it too
+	m_getters.wake_one();
+	return m_items.front();
+    }
+
+    // a full FIFO leaves item untouched, moved from or not
+    bool try_put( T&& item )
+    {
+	if(full())
+	    return false;
+
+	m_items.push_back( std::move(item) );
+	m_getters.wake_one();
+	return true;
+    }
+
+    bool try_put( const T& item )
+    {
+	if(full())
+	    return false;
+
+	m_items.push_back( item );
+	m_getters.wake_one();
+	return true;
+    }
+
+    bool try_get( T& item )
+    {
+	if(empty())
+	    return false;
+
+	item = std::move(m_items.front());
+	m_items.pop_front();
+	m_putters.wake_one();
+	return true;
+    }
+
+private:
+    size_t m_depth;
+    std::deque<T> m_items;
+    WaitQueue m_getters, m_putters;
+};
+
+
+template <class T>
+class Mailbox : public Fifo<T>
+{
+public:
+    Mailbox() : Fifo<T>(0) {}
+};
+
+
+class Semaphore
+{
+public:
+    Semaphore( int keys = 1 ) : m_keys( keys ) {}
+
+    // takes n keys, blocking until they are available
+    void get( Context *c, int n = 1 )
+    {
+	while(m_keys < n)
+	    m_waiters.wait(c);
+
+	m_keys -= n;
+
+	// what is left may satisfy the next waiter
+	if(m_keys > 0)
+	    m_waiters.wake_one();
+    }
+
+    bool try_get( int n = 1 )
+    {
+	if(m_keys < n)
+	    return false;
+
+	m_keys -= n;
+	return true;
+    }
+
+    void put( int n = 1 )
+    {
+	m_keys += n;
+	m_waiters.wake_one();
+    }
+
+    int keys() const
+    {
+	return m_keys;
+    }
+
+private:
+    int m_keys;
+    WaitQueue m_waiters;
+};
+
+#endif
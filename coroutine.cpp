@@ -0,0 +1,247 @@
+#include "coroutine.h"
+
+/*
+ Minimal context switch for AsmSwitch. A suspended coroutine is just a
+ stack pointer; the frame below it holds the callee-saved registers (and,
+ for the _fpu variants, the FP control state) pushed by coroutine_swap.
+ A new coroutine gets a fake frame that "returns" into coroutine_entry,
+ which calls entry(arg) - entry must never return.
+*/
+
+#ifdef COROUTINE_HAVE_ASM_SWITCH
+
+#if defined( __x86_64__ )
+
+/*
+ CFI: the switch routines describe their pushes, so that a profiler
+ sampling inside them can still unwind, and coroutine_entry marks the
+ outermost frame of every coroutine stack (no return address, rbp = 0), so
+ that unwinding by CFI or by frame pointers ends cleanly below callerStub
+ instead of running off into the stack memory.
+*/
+
+#define COROUTINE_PUSH(reg) \
+    "    pushq %" reg "\n" \
+    "    .cfi_adjust_cfa_offset 8\n" \
+    "    .cfi_rel_offset %" reg ", 0\n"
+
+#define COROUTINE_POP(reg) \
+    "    popq %" reg "\n" \
+    "    .cfi_adjust_cfa_offset -8\n" \
+    "    .cfi_restore %" reg "\n"
+
+#define COROUTINE_SAVE_REGS \
+    COROUTINE_PUSH("rbp") \
+    COROUTINE_PUSH("rbx") \
+    COROUTINE_PUSH("r12") \
+    COROUTINE_PUSH("r13") \
+    COROUTINE_PUSH("r14") \
+    COROUTINE_PUSH("r15")
+
+// the frame on the new stack has the same layout, so the CFI stays valid
+#define COROUTINE_RESTORE_REGS \
+    COROUTINE_POP("r15") \
+    COROUTINE_POP("r14") \
+    COROUTINE_POP("r13") \
+    COROUTINE_POP("r12") \
+    COROUTINE_POP("rbx") \
+    COROUTINE_POP("rbp") \
+    /* not ret: the return stack predictor would miss on every switch */ \
+    "    popq %rax\n" \
+    "    .cfi_adjust_cfa_offset -8\n" \
+    "    .cfi_register %rip, %rax\n" \
+    "    jmpq *%rax\n"
+
+asm(
+    ".text\n"
+
+    ".globl coroutine_swap\n"
+    ".type coroutine_swap, @function\n"
+    "coroutine_swap:\n"
+    "    .cfi_startproc\n"
+    COROUTINE_SAVE_REGS
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    COROUTINE_RESTORE_REGS
+    "    .cfi_endproc\n"
+    ".size coroutine_swap, .-coroutine_swap\n"
+
+    ".globl coroutine_swap_fpu\n"
+    ".type coroutine_swap_fpu, @function\n"
+    "coroutine_swap_fpu:\n"
+    "    .cfi_startproc\n"
+    COROUTINE_SAVE_REGS
+    "    subq $8, %rsp\n"
+    "    .cfi_adjust_cfa_offset 8\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    .cfi_adjust_cfa_offset -8\n"
+    COROUTINE_RESTORE_REGS
+    "    .cfi_endproc\n"
+    ".size coroutine_swap_fpu, .-coroutine_swap_fpu\n"
+
+    // r12 = entry, r13 = arg, rsp 16-byte aligned
+    ".type coroutine_entry, @function\n"
+    "coroutine_entry:\n"
+    "    .cfi_startproc\n"
+    "    .cfi_undefined %rip\n"
+    "    xorl %ebp, %ebp\n"
+    "    movq %r13, %rdi\n"
+    "    callq *%r12\n"
+    "    ud2\n"
+    "    .cfi_endproc\n"
+    ".size coroutine_entry, .-coroutine_entry\n"
+);
+
+extern "C" void coroutine_entry();
+
+extern "C" void *coroutine_init_stack( void *top, void (*entry)( intptr_t ), intptr_t arg, bool fpu )
+{
+    uint64_t *sp = (uint64_t *) ( (uintptr_t) top & ~(uintptr_t) 0x0f );
+
+    *--sp = (uint64_t) coroutine_entry;	// return address
+    *--sp = 0;				// rbp
+    *--sp = 0;				// rbx
+    *--sp = (uint64_t) entry;		// r12
+    *--sp = (uint64_t) arg;		// r13
+    *--sp = 0;				// r14
+    *--sp = 0;				// r15
+
+    if(fpu)
+    {
+	// start with the caller's FP control state
+	--sp;
+	asm volatile( "stmxcsr (%0)\n fnstcw 4(%0)" : : "r" (sp) : "memory" );
+    }
+
+    return sp;
+}
+
+#elif defined( __aarch64__ )
+
+// CFI as for x86-64: each pair is described relative to sp, which is
+// the same in both routines, and the frame on the new stack has the same
+// layout as the one saved
+#define COROUTINE_STP(a, b, off) \
+    "    stp " a ", " b ", [sp, #" #off "]\n" \
+    "    .cfi_rel_offset " a ", " #off "\n" \
+    "    .cfi_rel_offset " b ", " #off " + 8\n"
+
+#define COROUTINE_LDP(a, b, off) \
+    "    ldp " a ", " b ", [sp, #" #off "]\n" \
+    "    .cfi_restore " a "\n" \
+    "    .cfi_restore " b "\n"
+
+#define COROUTINE_SAVE_REGS \
+    COROUTINE_STP("x19", "x20", 0) \
+    COROUTINE_STP("x21", "x22", 16) \
+    COROUTINE_STP("x23", "x24", 32) \
+    COROUTINE_STP("x25", "x26", 48) \
+    COROUTINE_STP("x27", "x28", 64) \
+    COROUTINE_STP("x29", "x30", 80) \
+    COROUTINE_STP("d8", "d9", 96) \
+    COROUTINE_STP("d10", "d11", 112) \
+    COROUTINE_STP("d12", "d13", 128) \
+    COROUTINE_STP("d14", "d15", 144)
+
+// x30 is the return column: once reloaded, the return address is back in
+// the register br jumps through
+#define COROUTINE_RESTORE_REGS \
+    COROUTINE_LDP("x19", "x20", 0) \
+    COROUTINE_LDP("x21", "x22", 16) \
+    COROUTINE_LDP("x23", "x24", 32) \
+    COROUTINE_LDP("x25", "x26", 48) \
+    COROUTINE_LDP("x27", "x28", 64) \
+    COROUTINE_LDP("x29", "x30", 80) \
+    COROUTINE_LDP("d8", "d9", 96) \
+    COROUTINE_LDP("d10", "d11", 112) \
+    COROUTINE_LDP("d12", "d13", 128) \
+    COROUTINE_LDP("d14", "d15", 144)
+
+asm(
+    ".text\n"
+
+    ".globl coroutine_swap\n"
+    ".type coroutine_swap, %function\n"
+    "coroutine_swap:\n"
+    "    .cfi_startproc\n"
+    "    sub sp, sp, #160\n"
+    "    .cfi_adjust_cfa_offset 160\n"
+    COROUTINE_SAVE_REGS
+    "    mov x2, sp\n"
+    "    str x2, [x0]\n"
+    "    mov sp, x1\n"
+    COROUTINE_RESTORE_REGS
+    "    add sp, sp, #160\n"
+    "    .cfi_adjust_cfa_offset -160\n"
+    // not ret: the return stack predictor would miss on every switch
+    "    br x30\n"
+    "    .cfi_endproc\n"
+    ".size coroutine_swap, .-coroutine_swap\n"
+
+    ".globl coroutine_swap_fpu\n"
+    ".type coroutine_swap_fpu, %function\n"
+    "coroutine_swap_fpu:\n"
+    "    .cfi_startproc\n"
+    "    sub sp, sp, #176\n"
+    "    .cfi_adjust_cfa_offset 176\n"
+    COROUTINE_SAVE_REGS
+    "    mrs x3, fpcr\n"
+    "    str x3, [sp, #160]\n"
+    "    mov x2, sp\n"
+    "    str x2, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldr x3, [sp, #160]\n"
+    "    msr fpcr, x3\n"
+    COROUTINE_RESTORE_REGS
+    "    add sp, sp, #176\n"
+    "    .cfi_adjust_cfa_offset -176\n"
+    "    br x30\n"
+    "    .cfi_endproc\n"
+    ".size coroutine_swap_fpu, .-coroutine_swap_fpu\n"
+
+    // x19 = entry, x20 = arg; the outermost frame (see the x86-64 version)
+    ".type coroutine_entry, %function\n"
+    "coroutine_entry:\n"
+    "    .cfi_startproc\n"
+    "    .cfi_undefined x30\n"
+    "    mov x29, xzr\n"
+    "    mov x0, x20\n"
+    "    blr x19\n"
+    "    brk #0\n"
+    "    .cfi_endproc\n"
+    ".size coroutine_entry, .-coroutine_entry\n"
+);
+
+extern "C" void coroutine_entry();
+
+extern "C" void *coroutine_init_stack( void *top, void (*entry)( intptr_t ), intptr_t arg, bool fpu )
+{
+    int frame = fpu ? 176 : 160;
+    uint64_t *sp = (uint64_t *) ( ( (uintptr_t) top & ~(uintptr_t) 0x0f ) - frame );
+
+    for(int i = 0; i < frame / 8; i++)
+	sp[i] = 0;
+
+    sp[0] = (uint64_t) entry;		// x19
+    sp[1] = (uint64_t) arg;		// x20
+    sp[11] = (uint64_t) coroutine_entry;	// x30
+
+    if(fpu)
+    {
+	uint64_t fpcr;
+	asm volatile( "mrs %0, fpcr" : "=r" (fpcr) );
+	sp[20] = fpcr;
+    }
+
+    return sp;
+}
+
+#endif
+
+#endif
@@ -26,12 +26,239 @@
 #define __COROUTINE_H
 
 #include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <stdint.h>
 
-#include <boost/context/fcontext.hpp>
 #include <boost/version.hpp>
 
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#endif
+
+#if BOOST_VERSION >= 106100
+#include <boost/context/detail/fcontext.hpp>
+#else
+#include <boost/context/fcontext.hpp>
+#endif
+
+#include <ucontext.h>
+
 #include "delegate.h"
 
+/*
+ Context switch backends. Each one keeps the state of one coroutine inline
+ and provides:
+
+    make( stack, size, entry, arg ) - prepares entry(arg) to run on the stack
+    enter()                         - caller -> coroutine
+    leave()                         - coroutine -> caller
+    set_preserve_fpu( bool )        - whether switches save the FP control state
+
+ FcontextSwitch uses boost::context (any version), UcontextSwitch uses
+ swapcontext() (portable, but each switch is a sigprocmask syscall) and
+ AsmSwitch a minimal x86-64/aarch64 routine from coroutine.cpp, saving only
+ the callee-saved registers. The simulation kernel uses COROUTINE_SWITCH,
+ e.g. build with CXXFLAGS += -DCOROUTINE_SWITCH=AsmSwitch. bench_switch
+ measures them all.
+*/
+
+class FcontextSwitch
+{
+public:
+    FcontextSwitch() : m_entry( NULL ), m_preserveFPU( true ) {}
+
+    void make( void *stack, size_t size, void (*entry)( intptr_t ), intptr_t arg )
+    {
+        m_entry = entry;
+        m_arg = arg;
+
+        // make_fcontext leaves the frame pointer slot of its initial frame
+        // as it finds it: a zero ends the frame pointer chain at the
+        // trampoline instead of in stale stack memory
+        memset( (char *) stack + size - c_frameBytes, 0, c_frameBytes );
+
+#if BOOST_VERSION >= 106100
+        m_self = boost::context::detail::make_fcontext( (char *) stack + size, size, trampoline );
+#elif BOOST_VERSION >= 105600
+        m_self = boost::context::make_fcontext( (char *) stack + size, size, trampoline );
+#else
+        m_selfPtr = boost::context::make_fcontext( (char *) stack + size, size, trampoline );
+        m_self = *m_selfPtr;
+#endif
+        m_started = false;
+    }
+
+    void enter()
+    {
+#if BOOST_VERSION >= 106100
+        // the first switch hands over this, the trampoline needs it
+        boost::context::detail::transfer_t t =
+            boost::context::detail::jump_fcontext( m_self, m_started ? NULL : this );
+        m_self = t.fctx;
+#elif BOOST_VERSION >= 105600
+        boost::context::jump_fcontext( &m_caller, m_self, (intptr_t) this, m_preserveFPU );
+#else
+        boost::context::jump_fcontext( &m_caller, &m_self, (intptr_t) this, m_preserveFPU );
+#endif
+        m_started = true;
+    }
+
+    void leave()
+    {
+#if BOOST_VERSION >= 106100
+        boost::context::detail::transfer_t t = boost::context::detail::jump_fcontext( m_caller, NULL );
+        m_caller = t.fctx;
+#elif BOOST_VERSION >= 105600
+        boost::context::jump_fcontext( &m_self, m_caller, 0, m_preserveFPU );
+#else
+        boost::context::jump_fcontext( &m_self, &m_caller, 0, m_preserveFPU );
+#endif
+    }
+
+    // boost >= 1.61 always preserves the FP control state
+    void set_preserve_fpu( bool preserve )
+    {
+        m_preserveFPU = preserve;
+    }
+
+private:
+    // covers the initial frame of every make_fcontext() implementation
+    static const int c_frameBytes = 256;
+
+#if BOOST_VERSION >= 106100
+    static void trampoline( boost::context::detail::transfer_t t )
+    {
+        FcontextSwitch *s = static_cast<FcontextSwitch *>( t.data );
+
+        s->m_caller = t.fctx;
+        s->m_entry( s->m_arg );
+    }
+#else
+    static void trampoline( intptr_t data )
+    {
+        FcontextSwitch *s = reinterpret_cast<FcontextSwitch *>( data );
+
+        s->m_entry( s->m_arg );
+    }
+#endif
+
+    void (*m_entry)( intptr_t );
+    intptr_t m_arg;
+
+#if BOOST_VERSION >= 106100
+    boost::context::detail::fcontext_t m_self, m_caller;
+#elif BOOST_VERSION >= 105600
+    boost::context::fcontext_t m_self, m_caller;
+#else
+    boost::context::fcontext_t m_self, m_caller, *m_selfPtr;
+#endif
+    bool m_started;
+    bool m_preserveFPU;
+};
+
+
+class UcontextSwitch
+{
+public:
+    void make( void *stack, size_t size, void (*entry)( intptr_t ), intptr_t arg )
+    {
+        m_entry = entry;
+        m_arg = arg;
+
+        getcontext( &m_self );
+        m_self.uc_stack.ss_sp = stack;
+        m_self.uc_stack.ss_size = size;
+        m_self.uc_link = NULL;
+
+        // makecontext() only passes ints
+        uintptr_t p = (uintptr_t) this;
+        makecontext( &m_self, (void (*)()) trampoline, 2, (int) (p >> 32), (int) p );
+    }
+
+    void enter()
+    {
+        swapcontext( &m_caller, &m_self );
+    }
+
+    void leave()
+    {
+        swapcontext( &m_self, &m_caller );
+    }
+
+    // ucontext always saves the full FP environment
+    void set_preserve_fpu( bool preserve )
+    {
+    }
+
+private:
+    static void trampoline( int hi, int lo )
+    {
+        UcontextSwitch *s = reinterpret_cast<UcontextSwitch *>(
+            ( (uintptr_t) (unsigned) hi << 32 ) | (unsigned) lo );
+
+        s->m_entry( s->m_arg );
+    }
+
+    void (*m_entry)( intptr_t );
+    intptr_t m_arg;
+    ucontext_t m_self, m_caller;
+};
+
+
+#if defined( __x86_64__ ) || defined( __aarch64__ )
+#define COROUTINE_HAVE_ASM_SWITCH
+
+// coroutine.cpp: save the callee-saved registers on the current stack, store
+// the stack pointer in *from and continue on stack to; the _fpu variant also
+// saves the FP control state (x86-64: mxcsr/x87 cw, aarch64: fpcr)
+extern "C" void coroutine_swap( void **from, void *to );
+extern "C" void coroutine_swap_fpu( void **from, void *to );
+// builds the initial frame for entry(arg) at the top of a stack, returns its stack pointer
+extern "C" void *coroutine_init_stack( void *top, void (*entry)( intptr_t ), intptr_t arg, bool fpu );
+
+class AsmSwitch
+{
+public:
+    AsmSwitch() : m_preserveFPU( true ) {}
+
+    void make( void *stack, size_t size, void (*entry)( intptr_t ), intptr_t arg )
+    {
+        m_self = coroutine_init_stack( (char *) stack + size, entry, arg, m_preserveFPU );
+    }
+
+    void enter()
+    {
+        if( m_preserveFPU )
+            coroutine_swap_fpu( &m_caller, m_self );
+        else
+            coroutine_swap( &m_caller, m_self );
+    }
+
+    void leave()
+    {
+        if( m_preserveFPU )
+            coroutine_swap_fpu( &m_self, m_caller );
+        else
+            coroutine_swap( &m_self, m_caller );
+    }
+
+    // must not change while the coroutine is suspended (frame layouts differ)
+    void set_preserve_fpu( bool preserve )
+    {
+        m_preserveFPU = preserve;
+    }
+
+private:
+    void *m_self, *m_caller;
+    bool m_preserveFPU;
+};
+#endif
+
+#ifndef COROUTINE_SWITCH
+#define COROUTINE_SWITCH FcontextSwitch
+#endif
+
 /**
  *  Class COROUNTINE.
  *  Implements a coroutine. Wikipedia has a good explanation:
@@ -45,7 +272,8 @@
  *  preempted only when it deliberately yields the control to the caller. This way,
  *  we avoid concurrency problems such as locking / race conditions.
  *
- *  Uses boost::context library to do the actual context switching.
+ *  The actual context switching is done by the Switch backend (see above).
+ *  The stack is allocated by the first Call() and reused by the following ones.
  *
  *  This particular version takes a DELEGATE as an entry point, so it can invoke
  *  methods within a given object as separate coroutines.
@@ -53,13 +281,12 @@
  *  See coroutine_example.cpp for sample code.
  */
 
-template <class ReturnType, class ArgType>
+template <class ReturnType, class ArgType, class Switch = COROUTINE_SWITCH>
 class COROUTINE
 {
 public:
     COROUTINE() :
-        m_saved( NULL ), m_self( NULL ), m_stack( NULL ), m_stackSize( c_defaultStackSize ),
-        m_running( false )
+        m_func( NULL ), m_stack( NULL ), m_stackSize( c_defaultStackSize ), m_running( false )
     {
     }
 
@@ -68,26 +295,26 @@ public:
      * Creates a coroutine from a member method of an object
      */
     COROUTINE( ReturnType (*ptr)( ArgType ) ) :
-        m_func( ptr ), m_self( NULL ), m_saved( NULL ), m_stack( NULL ),
-        m_stackSize( c_defaultStackSize ), m_running( false )
+        m_func( ptr ), m_stack( NULL ), m_stackSize( c_defaultStackSize ), m_running( false )
     {
     }
 
-    /**
-     * Constructor
-     * Creates a coroutine from a delegate object
-     */
+    // the stack is owned, copy only the entry point
+    COROUTINE( const COROUTINE& b ) :
+        m_func( b.m_func ), m_stack( NULL ), m_stackSize( b.m_stackSize ), m_running( false )
+    {
+    }
 
-    ~COROUTINE()
+    COROUTINE& operator=( const COROUTINE& b )
     {
-        if( m_saved )
-            delete m_saved;
+        assert( !m_running );
 
-#if BOOST_VERSION >= 105600
-        if( m_self )
-            delete m_self;
-#endif
+        m_func = b.m_func;
+        return *this;
+    }
 
+    ~COROUTINE()
+    {
         if( m_stack )
             free( m_stack );
     }
@@ -101,7 +328,7 @@ public:
      */
     void Yield()
     {
-        jump( m_self, m_saved, 0 );
+        m_switch.leave();
     }
 
     /**
@@ -113,7 +340,7 @@ public:
     void Yield( ReturnType& aRetVal )
     {
         m_retVal = aRetVal;
-        jump( m_self, m_saved, 0 );
+        m_switch.leave();
     }
 
     /* Function Call()
@@ -124,30 +351,24 @@ public:
      */
     bool Call( ArgType aArgs )
     {
-        // fixme: Clean up stack stuff. Add a guard
-        m_stack = malloc( c_defaultStackSize );
+        if( !m_stack )
+            m_stack = malloc( m_stackSize );
 
         // align to 16 bytes
-        void* sp = (void*) ( ( ( (ptrdiff_t) m_stack ) + m_stackSize - 0xf ) & ( ~0x0f ) );
-
-        // correct the stack size
-        m_stackSize -= ( (size_t) m_stack + m_stackSize - (size_t) sp );
-
-        //assert( m_self == NULL );
-        //assert( m_saved == NULL );
+        size_t size = ( ( (uintptr_t) m_stack + m_stackSize ) & ~(uintptr_t) 0x0f ) - (uintptr_t) m_stack;
 
         m_args = &aArgs;
-#if BOOST_VERSION >= 105600
-        m_self = new boost::context::fcontext_t();
-        *m_self = boost::context::make_fcontext( sp, m_stackSize, callerStub );
-#else
-        m_self = boost::context::make_fcontext( sp, m_stackSize, callerStub );
+
+#ifdef __SANITIZE_ADDRESS__
+        // a reused stack still carries the redzones of frames that never
+        // returned; make() and the new frames write over them
+        ASAN_UNPOISON_MEMORY_REGION( m_stack, m_stackSize );
 #endif
-        m_saved = new boost::context::fcontext_t();
+        m_switch.make( m_stack, size, callerStub, reinterpret_cast<intptr_t>( this ) );
 
         m_running = true;
         // off we go!
-        jump( m_saved, m_self, reinterpret_cast<intptr_t>( this ) );
+        m_switch.enter();
         return m_running;
     }
 
@@ -160,7 +381,7 @@ public:
      */
     bool Resume()
     {
-        jump( m_saved, m_self, 0 );
+        m_switch.enter();
 
         return m_running;
     }
@@ -185,6 +406,17 @@ public:
         return m_running;
     }
 
+    /**
+     * Function SetPreserveFPU()
+     *
+     * Coroutines that do no floating point work can skip saving the FP
+     * control state on each switch (backends permitting). Call before Call().
+     */
+    void SetPreserveFPU( bool aPreserve )
+    {
+        m_switch.set_preserve_fpu( aPreserve );
+    }
+
 private:
     static const int c_defaultStackSize = 2000000;    // fixme: make configurable
 
@@ -192,25 +424,14 @@ private:
     static void callerStub( intptr_t aData )
     {
         // get pointer to self
-        COROUTINE<ReturnType, ArgType>* cor = reinterpret_cast<COROUTINE<ReturnType, ArgType>*>( aData );
+        COROUTINE<ReturnType, ArgType, Switch>* cor = reinterpret_cast<COROUTINE<ReturnType, ArgType, Switch>*>( aData );
 
         // call the coroutine method
         cor->m_retVal = cor->m_func( *cor->m_args );
         cor->m_running = false;
 
-        // go back to wherever we came from.
-        jump( cor->m_self, cor->m_saved, 0 );    // reinterpret_cast<intptr_t>( this ));
-    }
-
-    ///> Wrapper for jump_fcontext to assure compatibility between different boost versions
-    static inline intptr_t jump(boost::context::fcontext_t* aOld, boost::context::fcontext_t* aNew,
-                                intptr_t aP, bool aPreserveFPU = true )
-    {
-#if BOOST_VERSION >= 105600
-        return boost::context::jump_fcontext( aOld, *aNew, aP, aPreserveFPU );
-#else
-        return boost::context::jump_fcontext( aOld, aNew, aP, aPreserveFPU );
-#endif
+        // go back to wherever we came from, for good
+        cor->m_switch.leave();
     }
 
     template <typename T>
@@ -232,11 +453,8 @@ private:
     typename strip_ref<ArgType>::result* m_args;
     ReturnType m_retVal;
 
-    ///< saved caller context
-    boost::context::fcontext_t* m_saved;
-
-    ///< saved coroutine context
-    boost::context::fcontext_t* m_self;
+    ///< saved coroutine and caller contexts
+    Switch m_switch;
 
     ///< coroutine stack
     void* m_stack;
@@ -0,0 +1,302 @@
+#include <cstring>
+
+#include "coverage.h"
+
+static const char c_coverageMagic[8] = "SIMCOV1";
+
+Coverage::~Coverage()
+{
+    for(std::map<Logic *, Probe *>::iterator i = m_probes.begin(); i != m_probes.end(); ++i)
+    {
+	m_sim->remove_value_callback( i->first, on_change, i->second );
+	delete i->second;
+    }
+}
+
+Coverage::Probe *Coverage::probe( Logic *sig )
+{
+    std::map<Logic *, Probe *>::iterator i = m_probes.find(sig);
+
+    if(i != m_probes.end())
+	return i->second;
+
+    assert( sig->m_bits <= 64 );
+
+    Probe *p = new Probe;
+    p->m_sig = sig;
+    p->m_pending = 0;
+    p->m_rise.resize(sig->m_bits);
+    p->m_fall.resize(sig->m_bits);
+    memset( p->m_risePlanes, 0, sizeof(p->m_risePlanes) );
+    memset( p->m_fallPlanes, 0, sizeof(p->m_fallPlanes) );
+
+    m_probes[sig] = p;
+    m_sim->add_value_callback( sig, on_change, p );
+    return p;
+}
+
+void Coverage::track( Logic *sig )
+{
+    probe(sig);
+}
+
+void Coverage::track_all()
+{
+    BOOST_FOREACH(SigBase *s, m_sim->m_signals)
+	if( Logic *l = dynamic_cast<Logic *>(s) )
+	    track(l);
+}
+
+void Coverage::track_values( Logic *sig, bool transitions )
+{
+    assert( sig->m_bits <= c_maxBinBits );
+    assert( !transitions || sig->m_bits <= c_maxTransitionBits );
+
+    Probe *p = probe(sig);
+    size_t n = 1 << sig->m_bits;
+
+    p->m_values.resize(n);
+    if(transitions)
+	p->m_transitions.resize(n * n);
+
+    // the value we start with counts as seen
+    p->m_values[ sig->value() ]++;
+}
+
+void Coverage::on_change( const ValueChange& vc, void *arg )
+{
+    Probe *p = static_cast<Probe *>( arg );
+
+    add( p->m_risePlanes, ~vc.m_old & vc.m_new );
+    add( p->m_fallPlanes, vc.m_old & ~vc.m_new );
+
+    // before any counter can overflow its planes
+    if( ++p->m_pending == (1 << c_planes) - 1 )
+	flush(p);
+
+    if(!p->m_values.empty())
+    {
+	p->m_values[ vc.m_new ]++;
+
+	if(!p->m_transitions.empty())
+	    p->m_transitions[ vc.m_old * p->m_values.size() + vc.m_new ]++;
+    }
+}
+
+void Coverage::flush( Probe *p )
+{
+    for(int b = 0; b < p->m_rise.size(); b++)
+    {
+	uint64_t rise = 0, fall = 0;
+
+	for(int j = 0; j < c_planes; j++)
+	{
+	    rise |= ( (p->m_risePlanes[j] >> b) & 1 ) << j;
+	    fall |= ( (p->m_fallPlanes[j] >> b) & 1 ) << j;
+	}
+
+	p->m_rise[b] += rise;
+	p->m_fall[b] += fall;
+    }
+
+    memset( p->m_risePlanes, 0, sizeof(p->m_risePlanes) );
+    memset( p->m_fallPlanes, 0, sizeof(p->m_fallPlanes) );
+    p->m_pending = 0;
+}
+
+void Coverage::snapshot( CoverageDB& db )
+{
+    db.m_entries.clear();
+
+    for(std::map<Logic *, Probe *>::iterator i = m_probes.begin(); i != m_probes.end(); ++i)
+    {
+	Probe *p = i->second;
+	CoverageEntry e;
+
+	flush(p);
+
+	e.m_name = p->m_sig->name();
+	e.m_bits = p->m_sig->m_bits;
+	e.m_rise = p->m_rise;
+	e.m_fall = p->m_fall;
+	e.m_values = p->m_values;
+	e.m_transitions = p->m_transitions;
+	db.m_entries.push_back(e);
+    }
+}
+
+bool Coverage::write( const std::string filename )
+{
+    CoverageDB db;
+
+    snapshot(db);
+    return db.save(filename);
+}
+
+
+/*
+ File format, native byte order:
+    "SIMCOV1\0", uint32 n_entries
+    per entry: uint32 name length, name, uint32 bits, uint32 n_values,
+               uint32 n_transitions, uint64 rise[bits], fall[bits],
+               values[n_values], transitions[n_transitions]
+*/
+
+static bool write_u32( FILE *f, uint32_t v )
+{
+    return fwrite( &v, sizeof(v), 1, f ) == 1;
+}
+
+static bool write_counts( FILE *f, const std::vector<uint64_t>& v )
+{
+    return v.empty() || fwrite( &v[0], sizeof(uint64_t), v.size(), f ) == v.size();
+}
+
+static bool read_u32( FILE *f, uint32_t& v )
+{
+    return fread( &v, sizeof(v), 1, f ) == 1;
+}
+
+static bool read_counts( FILE *f, std::vector<uint64_t>& v, uint32_t n )
+{
+    v.resize(n);
+    return !n || fread( &v[0], sizeof(uint64_t), n, f ) == n;
+}
+
+bool CoverageDB::save( const std::string filename ) const
+{
+    FILE *f = fopen( filename.c_str(), "wb" );
+
+    if(!f)
+	return false;
+
+    bool ok = fwrite( c_coverageMagic, 8, 1, f ) == 1 && write_u32( f, m_entries.size() );
+
+    BOOST_FOREACH(const CoverageEntry& e, m_entries)
+    {
+	ok = ok && write_u32( f, e.m_name.size() ) && fwrite( e.m_name.data(), 1, e.m_name.size(), f ) == e.m_name.size();
+	ok = ok && write_u32( f, e.m_bits ) && write_u32( f, e.m_values.size() ) && write_u32( f, e.m_transitions.size() );
+	ok = ok && write_counts( f, e.m_rise ) && write_counts( f, e.m_fall );
+	ok = ok && write_counts( f, e.m_values ) && write_counts( f, e.m_transitions );
+    }
+
+    return !fclose(f) && ok;
+}
+
+bool CoverageDB::load( const std::string filename )
+{
+    FILE *f = fopen( filename.c_str(), "rb" );
+    char magic[8];
+    uint32_t n;
+
+    if(!f)
+	return false;
+
+    bool ok = fread( magic, 8, 1, f ) == 1 && !memcmp( magic, c_coverageMagic, 8 ) && read_u32( f, n );
+
+    m_entries.clear();
+
+    for(uint32_t i = 0; ok && i < n; i++)
+    {
+	CoverageEntry e;
+	uint32_t len, bits, n_values, n_transitions;
+
+	ok = read_u32( f, len ) && len < 4096;
+	if(ok)
+	{
+	    e.m_name.resize(len);
+	    ok = fread( &e.m_name[0], 1, len, f ) == len;
+	}
+
+	ok = ok && read_u32( f, bits ) && read_u32( f, n_values ) && read_u32( f, n_transitions ) && bits <= 64 &&
+	    n_values <= (1 << Coverage::c_maxBinBits) && n_transitions <= n_values * n_values;
+
+	e.m_bits = bits;
+	ok = ok && read_counts( f, e.m_rise, bits ) && read_counts( f, e.m_fall, bits );
+	ok = ok && read_counts( f, e.m_values, n_values ) && read_counts( f, e.m_transitions, n_transitions );
+
+	if(ok)
+	    m_entries.push_back(e);
+    }
+
+    fclose(f);
+    return ok;
+}
+
+static void add_counts( std::vector<uint64_t>& a, const std::vector<uint64_t>& b )
+{
+    for(int i = 0; i < a.size(); i++)
+	a[i] += b[i];
+}
+
+bool CoverageDB::merge( const CoverageDB& db )
+{
+    std::map<std::string, int> index;
+
+    for(int i = 0; i < m_entries.size(); i++)
+	index[ m_entries[i].m_name ] = i;
+
+    BOOST_FOREACH(const CoverageEntry& e, db.m_entries)
+    {
+	std::map<std::string, int>::iterator i = index.find(e.m_name);
+
+	if(i == index.end())
+	{
+	    index[e.m_name] = m_entries.size();
+	    m_entries.push_back(e);
+	    continue;
+	}
+
+	CoverageEntry& m = m_entries[i->second];
+
+	if( m.m_bits != e.m_bits )
+	    return false;
+
+	add_counts( m.m_rise, e.m_rise );
+	add_counts( m.m_fall, e.m_fall );
+
+	// bins only count where both runs collected them
+	if( m.m_values.size() == e.m_values.size() )
+	    add_counts( m.m_values, e.m_values );
+	if( m.m_transitions.size() == e.m_transitions.size() )
+	    add_counts( m.m_transitions, e.m_transitions );
+    }
+
+    return true;
+}
+
+static int hit( const std::vector<uint64_t>& v )
+{
+    int n = 0;
+    BOOST_FOREACH(uint64_t c, v)
+	n += c ? 1 : 0;
+    return n;
+}
+
+void CoverageDB::report( FILE *f ) const
+{
+    int total_bits = 0, total_toggled = 0;
+
+    BOOST_FOREACH(const CoverageEntry& e, m_entries)
+    {
+	int toggled = 0;
+
+	// a bit is covered once it went both ways
+	for(int b = 0; b < e.m_bits; b++)
+	    toggled += (e.m_rise[b] && e.m_fall[b]) ? 1 : 0;
+
+	fprintf(f, "%-24s toggle %3d/%-3d", e.m_name.c_str(), toggled, e.m_bits);
+
+	if(!e.m_values.empty())
+	    fprintf(f, "  values %d/%d", hit(e.m_values), (int) e.m_values.size());
+	if(!e.m_transitions.empty())
+	    fprintf(f, "  transitions %d", hit(e.m_transitions));
+	fprintf(f, "\n");
+
+	total_bits += e.m_bits;
+	total_toggled += toggled;
+    }
+
+    fprintf(f, "toggle coverage: %d/%d bits (%.1f%%)\n", total_toggled, total_bits,
+	    total_bits ? 100.0 * total_toggled / total_bits : 0.0);
+}
@@ -0,0 +1,99 @@
+#ifndef __COVERAGE_H
+#define __COVERAGE_H
+
+#include "sim.h"
+
+/*
+ Toggle and value coverage, collected in the commit loop.
+
+ Coverage hooks a value change callback on every covered signal, so there
+ are no monitor processes and uncovered signals cost nothing. Per change,
+ rise = ~old & new and fall = old & ~new are added to per-bit counters kept
+ bit-sliced: plane j holds bit j of the counters of all 64 signal bits, so
+ one increment is a ripple carry over c_planes words. The planes are
+ flushed into plain 64-bit totals every 2^c_planes - 1 changes.
+
+ Small signals (up to c_maxBinBits, e.g. FSM state registers) can also
+ count hits per value and, up to c_maxTransitionBits, per old -> new
+ transition.
+
+ Results go to a CoverageDB, saved in a compact binary format; covmerge
+ combines the databases of a regression.
+*/
+
+struct CoverageEntry
+{
+    std::string m_name;
+    int m_bits;
+    std::vector<uint64_t> m_rise, m_fall;	// per bit
+    std::vector<uint64_t> m_values;		// per value, empty if not binned
+    std::vector<uint64_t> m_transitions;	// [old * n_values + new], empty if not binned
+};
+
+class CoverageDB
+{
+public:
+    bool load( const std::string filename );
+    bool save( const std::string filename ) const;
+
+    // adds the counts of db, entries are matched by name
+    bool merge( const CoverageDB& db );
+
+    // per-signal toggle and bin coverage, and the totals
+    void report( FILE *f ) const;
+
+    std::vector<CoverageEntry> m_entries;
+};
+
+class Coverage
+{
+public:
+    static const int c_planes = 8;
+    static const int c_maxBinBits = 8;
+    static const int c_maxTransitionBits = 6;
+
+    Coverage( Simulation *sim ) : m_sim( sim ) {}
+    ~Coverage();
+
+    // toggle coverage of every bit of sig
+    void track( Logic *sig );
+    // all Logic signals of the simulation
+    void track_all();
+    // also count values (and transitions) of a signal of up to c_maxBinBits bits
+    void track_values( Logic *sig, bool transitions = false );
+
+    // current counts
+    void snapshot( CoverageDB& db );
+    bool write( const std::string filename );
+
+private:
+    struct Probe
+    {
+	Logic *m_sig;
+	uint64_t m_risePlanes[c_planes], m_fallPlanes[c_planes];
+	int m_pending;
+	std::vector<uint64_t> m_rise, m_fall;
+	std::vector<uint64_t> m_values, m_transitions;
+    };
+
+    static void on_change( const ValueChange& vc, void *arg );
+
+    static void add( uint64_t *planes, uint64_t mask )
+    {
+	for(int j = 0; j < c_planes && mask; j++)
+	{
+	    uint64_t carry = planes[j] & mask;
+	    planes[j] ^= mask;
+	    mask = carry;
+	}
+    }
+
+    static void flush( Probe *p );
+
+    Probe *probe( Logic *sig );
+
+    Simulation *m_sim;
+    std::map<Logic *, Probe *> m_probes;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "coverage.h"
+
+// combines the coverage databases of a regression into one and prints
+// the merged coverage
+
+int main(int argc, char *argv[])
+{
+    if(argc < 3)
+    {
+	fprintf(stderr, "usage: %s output.cov input.cov...\n", argv[0]);
+	return 1;
+    }
+
+    CoverageDB merged;
+
+    for(int i = 2; i < argc; i++)
+    {
+	CoverageDB db;
+
+	if( !db.load(argv[i]) )
+	{
+	    fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[i]);
+	    return 1;
+	}
+
+	if( !merged.merge(db) )
+	{
+	    fprintf(stderr, "%s: %s does not match the other databases\n", argv[0], argv[i]);
+	    return 1;
+	}
+    }
+
+    if( !merged.save(argv[1]) )
+    {
+	fprintf(stderr, "%s: cannot write %s\n", argv[0], argv[1]);
+	return 1;
+    }
+
+    merged.report(stdout);
+    return 0;
+}
@@ -0,0 +1,292 @@
+#include "history.h"
+
+// an entry never takes more than two 10-byte varints
+static const int c_maxEntry = 20;
+
+static int put_varint( uint8_t *p, uint64_t v )
+{
+    int n = 0;
+
+    while(v >= 0x80)
+    {
+	p[n++] = (v & 0x7f) | 0x80;
+	v >>= 7;
+    }
+
+    p[n++] = v;
+    return n;
+}
+
+static uint64_t get_varint( const uint8_t *& p )
+{
+    uint64_t v = 0;
+    int shift = 0;
+
+    while(*p & 0x80)
+    {
+	v |= (uint64_t) (*p++ & 0x7f) << shift;
+	shift += 7;
+    }
+
+    v |= (uint64_t) *p++ << shift;
+    return v;
+}
+
+// small positive and negative deltas both become small unsigned numbers
+static uint64_t zigzag( uint64_t delta )
+{
+    return (delta << 1) ^ (uint64_t) ( (int64_t) delta >> 63 );
+}
+
+static uint64_t unzigzag( uint64_t v )
+{
+    return (v >> 1) ^ -(v & 1);
+}
+
+
+History::History( Simulation *sim, int64_t retention ) :
+    m_sim( sim ), m_retention( retention )
+{
+}
+
+History::~History()
+{
+    for(std::map<const SigBase *, Log *>::iterator i = m_signals.begin(); i != m_signals.end(); ++i)
+    {
+	m_sim->remove_value_callback( const_cast<SigBase *>(i->first), on_change, i->second );
+	delete_log( i->second );
+    }
+
+    for(std::map<const Memory *, WordLogs *>::iterator i = m_memories.begin(); i != m_memories.end(); ++i)
+    {
+	m_sim->remove_value_callback( i->second->m_mem, on_write, i->second );
+
+	for(std::map<uint64_t, Log *>::iterator j = i->second->m_logs.begin(); j != i->second->m_logs.end(); ++j)
+	    delete_log( j->second );
+	delete i->second;
+    }
+}
+
+History::Log *History::new_log( int64_t time, uint64_t value )
+{
+    Log *log = new Log;
+
+    log->m_startTime = time;
+    log->m_startValue = value;
+    log->m_history = this;
+    return log;
+}
+
+void History::delete_log( Log *log )
+{
+    BOOST_FOREACH(Chunk *c, log->m_chunks)
+	delete c;
+    delete log;
+}
+
+void History::track( SigBase *sig )
+{
+    assert( !dynamic_cast<Memory *>(sig) && "memories are tracked by word (track_words())" );
+
+    if(tracked(sig))
+	return;
+
+    Log *log = new_log( m_sim->m_time, sig->raw_value() );
+    m_signals[sig] = log;
+
+    m_sim->add_value_callback( sig, on_change, log );
+}
+
+void History::track_words( Memory *mem, uint64_t first, uint64_t n )
+{
+    assert( first + n <= mem->size() );
+
+    WordLogs *&w = m_memories[mem];
+
+    if(!w)
+    {
+	w = new WordLogs;
+	w->m_mem = mem;
+	w->m_history = this;
+	m_sim->add_value_callback( mem, on_write, w );
+    }
+
+    for(uint64_t addr = first; addr < first + n; addr++)
+    {
+	Log *&log = w->m_logs[addr];
+
+	if(!log)
+	    log = new_log( m_sim->m_time, mem->m_data[addr] );
+    }
+}
+
+void History::track_all()
+{
+    BOOST_FOREACH(SigBase *s, m_sim->m_signals)
+    {
+	if(Memory *m = dynamic_cast<Memory *>(s))
+	    track_words( m, 0, m->m_traceWords );
+	else
+	    track(s);
+    }
+}
+
+void History::on_change( const ValueChange& vc, void *arg )
+{
+    Log *log = static_cast<Log *>( arg );
+
+    log->m_history->append( log, vc.m_time, vc.m_new );
+}
+
+void History::on_write( const ValueChange& vc, void *arg )
+{
+    WordLogs *w = static_cast<WordLogs *>( arg );
+
+    BOOST_FOREACH(uint64_t addr, w->m_mem->dirty_words())
+    {
+	std::map<uint64_t, Log *>::iterator i = w->m_logs.find(addr);
+
+	if(i != w->m_logs.end())
+	    w->m_history->append( i->second, vc.m_time, w->m_mem->m_data[addr] );
+    }
+}
+
+void History::append( Log *log, int64_t time, uint64_t value )
+{
+    Chunk *c = log->m_chunks.empty() ? NULL : log->m_chunks.back();
+
+    // words stay dirty over the commits of a cycle-based half period
+    if(value == (c ? c->m_lastValue : log->m_startValue))
+	return;
+
+    // the first change opens the log, starting with the tracked value
+    if(!c)
+    {
+	c = new Chunk;
+	c->m_startTime = c->m_lastTime = log->m_startTime;
+	c->m_startValue = c->m_lastValue = log->m_startValue;
+	c->m_used = 0;
+	log->m_chunks.push_back(c);
+    }
+
+    if(c->m_used + c_maxEntry > c_chunkSize)
+    {
+	c = new Chunk;
+	c->m_startTime = c->m_lastTime = time;
+	c->m_startValue = c->m_lastValue = value;
+	c->m_used = 0;
+	log->m_chunks.push_back(c);
+    } else {
+	c->m_used += put_varint( c->m_data + c->m_used, time - c->m_lastTime );
+	c->m_used += put_varint( c->m_data + c->m_used, zigzag( value - c->m_lastValue ) );
+	c->m_lastTime = time;
+	c->m_lastValue = value;
+    }
+
+    // keep the chunk that covers the start of the window
+    if(m_retention)
+    {
+	while( log->m_chunks.size() > 1 && log->m_chunks[1]->m_startTime <= time - m_retention )
+	{
+	    delete log->m_chunks.front();
+	    log->m_chunks.pop_front();
+	}
+    }
+}
+
+uint64_t History::lookup( const Log *log, int64_t t, bool before ) const
+{
+    const std::deque<Chunk *>& chunks = log->m_chunks;
+
+    // unchanged since it was tracked
+    if(chunks.empty())
+	return log->m_startValue;
+
+    // last chunk starting at or before t (before: strictly before t)
+    int lo = 0, hi = chunks.size();
+
+    while(lo < hi)
+    {
+	int mid = (lo + hi) / 2;
+	bool starts_in = before ? chunks[mid]->m_startTime < t : chunks[mid]->m_startTime <= t;
+
+	if(starts_in)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    if(lo == 0)
+	return chunks[0]->m_startValue;
+
+    const Chunk *c = chunks[lo - 1];
+    const uint8_t *p = c->m_data, *end = c->m_data + c->m_used;
+    int64_t time = c->m_startTime;
+    uint64_t value = c->m_startValue;
+
+    while(p < end)
+    {
+	int64_t next_time = time + get_varint(p);
+	uint64_t next_value = value + unzigzag( get_varint(p) );
+
+	if( before ? next_time >= t : next_time > t )
+	    break;
+
+	time = next_time;
+	value = next_value;
+    }
+
+    return value;
+}
+
+uint64_t History::value_at( const SigBase *sig, int64_t t ) const
+{
+    std::map<const SigBase *, Log *>::const_iterator i = m_signals.find(sig);
+
+    assert( i != m_signals.end() && "signal not tracked" );
+    return lookup( i->second, t, false );
+}
+
+uint64_t History::value_before( const SigBase *sig, int64_t t ) const
+{
+    std::map<const SigBase *, Log *>::const_iterator i = m_signals.find(sig);
+
+    assert( i != m_signals.end() && "signal not tracked" );
+    return lookup( i->second, t, true );
+}
+
+const History::Log *History::word_log( const Memory *mem, uint64_t addr ) const
+{
+    std::map<const Memory *, WordLogs *>::const_iterator i = m_memories.find(mem);
+
+    assert( i != m_memories.end() && "memory not tracked" );
+
+    std::map<uint64_t, Log *>::const_iterator j = i->second->m_logs.find(addr);
+
+    assert( j != i->second->m_logs.end() && "word not tracked" );
+    return j->second;
+}
+
+uint64_t History::word_at( const Memory *mem, uint64_t addr, int64_t t ) const
+{
+    return lookup( word_log(mem, addr), t, false );
+}
+
+uint64_t History::word_before( const Memory *mem, uint64_t addr, int64_t t ) const
+{
+    return lookup( word_log(mem, addr), t, true );
+}
+
+size_t History::memory_used() const
+{
+    size_t rv = 0;
+
+    for(std::map<const SigBase *, Log *>::const_iterator i = m_signals.begin(); i != m_signals.end(); ++i)
+	rv += i->second->m_chunks.size() * sizeof(Chunk);
+
+    for(std::map<const Memory *, WordLogs *>::const_iterator i = m_memories.begin(); i != m_memories.end(); ++i)
+	for(std::map<uint64_t, Log *>::const_iterator j = i->second->m_logs.begin(); j != i->second->m_logs.end(); ++j)
+	    rv += j->second->m_chunks.size() * sizeof(Chunk);
+
+    return rv;
+}
@@ -0,0 +1,124 @@
+#ifndef __HISTORY_H
+#define __HISTORY_H
+
+#include <deque>
+
+#include "sim.h"
+#include "memory.h"
+
+/*
+ In-memory signal history for assertions and debug code: the value of a
+ signal at any past time, or $past-style "n clock cycles ago".
+
+ Tracked signals record their changes through value change callbacks
+ (Simulation::add_value_callback()), untracked ones cost nothing. Each
+ signal has an append-only log of fixed size chunks, allocated from its
+ first change on; an entry is the time delta and the (zigzag) value delta
+ to the previous entry, as varints, so a counter step takes two bytes.
+ Chunks start with an absolute time/value, a lookup is a binary search over
+ the chunks plus a scan of one chunk.
+
+ A Memory has no single value (its raw_value() is the last written
+ address): its words are tracked one by one (track_words()), each with its
+ own log fed from the word writes.
+
+ With a retention window, chunks that only hold changes older than the
+ window are released, bounding the memory use.
+*/
+
+class History
+{
+public:
+    // retention: time units of history to keep, 0 keeps everything
+    History( Simulation *sim, int64_t retention = 0 );
+    ~History();
+
+    // starts recording sig (its current value counts from now)
+    void track( SigBase *sig );
+    // starts recording words [first, first + n) of mem
+    void track_words( Memory *mem, uint64_t first, uint64_t n );
+    // all signals, and the words of the memories that VCD files show
+    void track_all();
+
+    bool tracked( const SigBase *sig ) const
+    {
+	return m_signals.count(sig) != 0;
+    }
+
+    /**
+     * Function value_at()
+     * Raw value of sig at the end of time t, after all its changes at t.
+     * Times before the oldest retained change give the oldest known value.
+     */
+    uint64_t value_at( const SigBase *sig, int64_t t ) const;
+
+    // raw value just before the changes at time t
+    uint64_t value_before( const SigBase *sig, int64_t t ) const;
+
+    // the same for a tracked memory word
+    uint64_t word_at( const Memory *mem, uint64_t addr, int64_t t ) const;
+    uint64_t word_before( const Memory *mem, uint64_t addr, int64_t t ) const;
+
+    LogicValue at( const Logic& sig, int64_t t ) const
+    {
+	return LogicValue( sig.m_bits, value_at(&sig, t) );
+    }
+
+    /**
+     * Function past()
+     * Like $past(sig, n) in a process woken by a clock edge, for a clock of
+     * the given period: the value sampled n edges ago, i.e. just before the
+     * edge at now - n * period.
+     */
+    LogicValue past( const Logic& sig, int n, int64_t period ) const
+    {
+	return LogicValue( sig.m_bits, value_before(&sig, m_sim->m_time - n * period) );
+    }
+
+    // bytes held by all logs
+    size_t memory_used() const;
+
+private:
+    static const int c_chunkSize = 4096;
+
+    struct Chunk
+    {
+	int64_t m_startTime, m_lastTime;
+	uint64_t m_startValue, m_lastValue;
+	int m_used;
+	uint8_t m_data[c_chunkSize];
+    };
+
+    struct Log
+    {
+	// the value when tracking started, kept here until the first change
+	int64_t m_startTime;
+	uint64_t m_startValue;
+	std::deque<Chunk *> m_chunks;
+	History *m_history;
+    };
+
+    // the tracked words of a memory, by address
+    struct WordLogs
+    {
+	Memory *m_mem;
+	std::map<uint64_t, Log *> m_logs;
+	History *m_history;
+    };
+
+    static void on_change( const ValueChange& vc, void *arg );
+    static void on_write( const ValueChange& vc, void *arg );
+
+    Log *new_log( int64_t time, uint64_t value );
+    void delete_log( Log *log );
+    void append( Log *log, int64_t time, uint64_t value );
+    uint64_t lookup( const Log *log, int64_t t, bool before ) const;
+    const Log *word_log( const Memory *mem, uint64_t addr ) const;
+
+    Simulation *m_sim;
+    int64_t m_retention;
+    std::map<const SigBase *, Log *> m_signals;
+    std::map<const Memory *, WordLogs *> m_memories;
+};
+
+#endif
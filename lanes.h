@@ -0,0 +1,299 @@
+#ifndef __LANES_H
+#define __LANES_H
+
+#include "sim.h"
+
+/*
+ Multi-instance ("lane") signals for batch runs of independent testbenches.
+
+ Lanes<N> is a bit vector value replicated over N independent lanes, e.g. N
+ operand pairs fed through one copy of the design. All operators work lane by
+ lane over fixed-size arrays, which the compiler turns into SIMD code; the
+ control flow of the processes is shared by all lanes. Where the lanes
+ diverge, compute both alternatives and pick per lane with select(), e.g.
+
+    c->assign( dividend_copy, select( !diff.range(63), diff, dividend_copy ) );
+
+ LogicLanes<N> is the corresponding signal. N may not exceed 64 (lane masks
+ are returned as uint64_t).
+*/
+
+template <int N>
+struct Lanes
+{
+    Lanes( int bits = 1 ) : m_bits( bits )
+    {
+	for(int i = 0; i < N; i++)
+	    m_value[i] = 0;
+    }
+
+    // same value in every lane
+    static Lanes broadcast( int bits, uint64_t value )
+    {
+	Lanes rv(bits);
+	for(int i = 0; i < N; i++)
+	    rv.m_value[i] = value & rv.mask();
+	return rv;
+    }
+
+    uint64_t mask() const
+    {
+	return m_bits >= 64 ? ~0ULL : (1ULL << m_bits) - 1;
+    }
+
+    uint64_t lane( int i ) const
+    {
+	return m_value[i];
+    }
+
+    void set_lane( int i, uint64_t value )
+    {
+	m_value[i] = value & mask();
+    }
+
+    // bit i set if lane i is non-zero
+    uint64_t nonzero() const
+    {
+	uint64_t rv = 0;
+	for(int i = 0; i < N; i++)
+	    rv |= (uint64_t) (m_value[i] != 0) << i;
+	return rv;
+    }
+
+    bool any() const
+    {
+	return nonzero() != 0;
+    }
+
+    bool all() const
+    {
+	return nonzero() == ( N == 64 ? ~0ULL : (1ULL << N) - 1 );
+    }
+
+    bool same( const Lanes& b ) const
+    {
+	uint64_t diff = 0;
+	for(int i = 0; i < N; i++)
+	    diff |= m_value[i] ^ b.m_value[i];
+	return !diff;
+    }
+
+    Lanes range( int rmax, int rmin ) const
+    {
+	assert (rmax >= rmin);
+
+	Lanes rv(rmax - rmin + 1);
+	uint64_t m = rv.mask();
+	for(int i = 0; i < N; i++)
+	    rv.m_value[i] = (m_value[i] >> rmin) & m;
+	return rv;
+    }
+
+    Lanes range( int bit ) const
+    {
+	return range(bit, bit);
+    }
+
+    Lanes operator>>( int b ) const
+    {
+	Lanes rv(m_bits);
+	for(int i = 0; i < N; i++)
+	    rv.m_value[i] = m_value[i] >> b;
+	return rv;
+    }
+
+    Lanes operator<<( int b ) const
+    {
+	Lanes rv(m_bits);
+	uint64_t m = mask();
+	for(int i = 0; i < N; i++)
+	    rv.m_value[i] = (m_value[i] << b) & m;
+	return rv;
+    }
+
+#define LANES_BINARY_OP(op) \
+    Lanes operator op ( const Lanes& b ) const \
+    { \
+	Lanes rv(m_bits); \
+	uint64_t m = mask(); \
+	for(int i = 0; i < N; i++) \
+	    rv.m_value[i] = (m_value[i] op b.m_value[i]) & m; \
+	return rv; \
+    }
+
+    LANES_BINARY_OP(+)
+    LANES_BINARY_OP(-)
+    LANES_BINARY_OP(^)
+    LANES_BINARY_OP(|)
+    LANES_BINARY_OP(&)
+
+#undef LANES_BINARY_OP
+
+    Lanes operator||( const Lanes& b ) const
+    {
+	Lanes rv(1);
+	for(int i = 0; i < N; i++)
+	    rv.m_value[i] = (m_value[i] != 0) | (b.m_value[i] != 0);
+	return rv;
+    }
+
+    Lanes operator&&( const Lanes& b ) const
+    {
+	Lanes rv(1);
+	for(int i = 0; i < N; i++)
+	    rv.m_value[i] = (m_value[i] != 0) & (b.m_value[i] != 0);
+	return rv;
+    }
+
+    Lanes operator~() const
+    {
+	Lanes rv(m_bits);
+	uint64_t m = mask();
+	for(int i = 0; i < N; i++)
+	    rv.m_value[i] = ~m_value[i] & m;
+	return rv;
+    }
+
+    Lanes operator!() const
+    {
+	Lanes rv(m_bits);
+	for(int i = 0; i < N; i++)
+	    rv.m_value[i] = (m_value[i] == 0);
+	return rv;
+    }
+
+    int m_bits;
+    alignas(64) uint64_t m_value[N];
+};
+
+// lane-wise comparisons, 1-bit results
+#define LANES_COMPARE(name, op) \
+template <int N> \
+Lanes<N> name ( const Lanes<N>& a, const Lanes<N>& b ) \
+{ \
+    Lanes<N> rv(1); \
+    for(int i = 0; i < N; i++) \
+	rv.m_value[i] = (a.m_value[i] op b.m_value[i]); \
+    return rv; \
+}
+
+LANES_COMPARE(eq, ==)
+LANES_COMPARE(ne, !=)
+LANES_COMPARE(lt, <)
+LANES_COMPARE(gt, >)
+
+#undef LANES_COMPARE
+
+template <int N>
+Lanes<N> concat( const Lanes<N>& a, const Lanes<N>& b )
+{
+    Lanes<N> rv(a.m_bits + b.m_bits);
+    for(int i = 0; i < N; i++)
+	rv.m_value[i] = (a.m_value[i] << b.m_bits) | b.m_value[i];
+    return rv;
+}
+
+// per lane: cond ? a : b (width of a)
+template <int N>
+Lanes<N> select( const Lanes<N>& cond, const Lanes<N>& a, const Lanes<N>& b )
+{
+    Lanes<N> rv(a.m_bits);
+    for(int i = 0; i < N; i++)
+    {
+	uint64_t m = -(uint64_t) (cond.m_value[i] != 0);
+	rv.m_value[i] = (a.m_value[i] & m) | (b.m_value[i] & ~m);
+    }
+    return rv;
+}
+
+
+template <int N>
+class LogicLanes : public SigBase, public Lanes<N>
+{
+public:
+    typedef Lanes<N> ValueType;
+
+    LogicLanes( int bits = 1, string name = "?" ) : SigBase(name), Lanes<N>(bits)
+    {
+	for(int i = 0; i < N; i++)
+	    m_old_value[i] = 0;
+    }
+
+    virtual LogicLanes *clone() const
+    {
+	return make_driver(*this);
+    }
+
+    LogicLanes *make_driver( const Lanes<N>& value ) const
+    {
+	LogicLanes *l = new LogicLanes(this->m_bits);
+	uint64_t m = this->mask();
+	for(int i = 0; i < N; i++)
+	    l->m_value[i] = value.m_value[i] & m;
+	return l;
+    }
+
+    bool equals( const Lanes<N>& value ) const
+    {
+	return this->same(value);
+    }
+
+    bool operator!=( const LogicLanes& b ) const
+    {
+	return !this->same(b);
+    }
+
+    virtual void copy_value( const SigBase *b )
+    {
+	const LogicLanes *l = static_cast<const LogicLanes *>(b);
+	for(int i = 0; i < N; i++)
+	{
+	    m_old_value[i] = this->m_value[i];
+	    this->m_value[i] = l->m_value[i];
+	}
+    }
+
+    virtual bool changed() const
+    {
+	uint64_t diff = 0;
+	for(int i = 0; i < N; i++)
+	    diff |= this->m_value[i] ^ m_old_value[i];
+	return diff != 0;
+    }
+
+    // lanes that changed in the last commit
+    uint64_t changed_lanes() const
+    {
+	uint64_t rv = 0;
+	for(int i = 0; i < N; i++)
+	    rv |= (uint64_t) (this->m_value[i] != m_old_value[i]) << i;
+	return rv;
+    }
+
+    void clear_changed()
+    {
+	for(int i = 0; i < N; i++)
+	    m_old_value[i] = this->m_value[i];
+    }
+
+    void initial( const Lanes<N>& value )
+    {
+	for(int i = 0; i < N; i++)
+	    this->m_value[i] = value.m_value[i] & this->mask();
+    }
+
+    const Lanes<N>& value() const
+    {
+	return *this;
+    }
+
+    // observers see lane 0
+    virtual uint64_t raw_value() const
+    {
+	return this->m_value[0];
+    }
+
+    alignas(64) uint64_t m_old_value[N];
+};
+
+#endif
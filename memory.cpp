@@ -0,0 +1,72 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include "memory.h"
+
+// memories up to this size appear completely in VCD files by default
+static const uint64_t c_defaultTraceWords = 4096;
+
+Memory::Memory( int bits, uint64_t n_words, string name ) :
+    SigBase( name ), m_bits( bits ), m_words( n_words ), m_dirtyMap( (n_words + 63) / 64, 0 ),
+    m_traced( false )
+{
+    long page = sysconf(_SC_PAGESIZE);
+
+    assert( bits >= 1 && bits <= 64 );
+
+    m_traceWords = n_words <= c_defaultTraceWords ? n_words : 0;
+
+    // zero pages are only materialized when written
+    m_mapSize = ( (n_words * sizeof(uint64_t) + page - 1) / page ) * page;
+    void *p = mmap( NULL, m_mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+    if(p == MAP_FAILED)
+	throw std::runtime_error("Memory: can't allocate " + name);
+
+    m_data = static_cast<uint64_t *>( p );
+}
+
+bool Memory::load( const std::string filename, uint64_t first_word )
+{
+    struct stat st;
+    long page = sysconf(_SC_PAGESIZE);
+    int fd = open( filename.c_str(), O_RDONLY );
+
+    if(fd < 0)
+	return false;
+
+    if( fstat(fd, &st) < 0 || st.st_size % sizeof(uint64_t) ||
+	first_word + st.st_size / sizeof(uint64_t) > m_words )
+    {
+	close(fd);
+	return false;
+    }
+
+    uint64_t offset = first_word * sizeof(uint64_t);
+    bool ok = true;
+
+    if( offset % page == 0 )
+    {
+	// replace the anonymous pages by a private mapping of the file: pages
+	// are read on first access and copied on first write. A partial last
+	// page is copied, so the words after the image keep their values.
+	size_t len = ( st.st_size / page ) * page;
+
+	if(len)
+	    ok = mmap( reinterpret_cast<char *>(m_data) + offset, len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_FIXED, fd, 0 ) != MAP_FAILED;
+
+	if(ok && len < st.st_size)
+	    ok = pread( fd, reinterpret_cast<char *>(m_data) + offset + len, st.st_size - len, len ) == st.st_size - len;
+    } else {
+	ok = pread( fd, m_data + first_word, st.st_size, 0 ) == st.st_size;
+    }
+
+    close(fd);
+    return ok;
+}
@@ -0,0 +1,178 @@
+#ifndef __MEMORY_H
+#define __MEMORY_H
+
+#include <sys/mman.h>
+
+#include "sim.h"
+
+/*
+ Memory array signal: n_words words of up to 64 bits in one contiguous
+ buffer, with a single SigBase (name, ID, set entry) for the whole array.
+
+ Processes read words directly and post writes with write(), which appends
+ to a flat write log. The commit applies the log and marks the words that
+ really changed as dirty. Processes can wait for any write to the array
+ (c->wait_signal(mem)) or for a particular word (mem.wait_word(c, addr)).
+
+ The storage is anonymous memory, so untouched words cost no RAM, and
+ load() maps an image file over it copy-on-write for a fast backdoor
+ preload.
+*/
+
+class Memory : public SigBase
+{
+public:
+    Memory( int bits, uint64_t n_words, string name = "?" );
+
+    virtual ~Memory()
+    {
+	munmap( m_data, m_mapSize );
+    }
+
+    virtual SigBase *clone() const
+    {
+	assert( false && "memories are written through write(), not assign()" );
+	return NULL;
+    }
+
+    virtual void copy_value( const SigBase *b )
+    {
+    }
+
+    uint64_t size() const
+    {
+	return m_words;
+    }
+
+    uint64_t mask() const
+    {
+	return LogicValue::width_mask(m_bits);
+    }
+
+    LogicValue read( uint64_t addr ) const
+    {
+	assert( addr < m_words );
+	return LogicValue( m_bits, m_data[addr] );
+    }
+
+    LogicValue operator[]( uint64_t addr ) const
+    {
+	return read(addr);
+    }
+
+    // posts a write, visible after the commit of the current delta
+    void write( Context *c, uint64_t addr, const LogicValue& value )
+    {
+	assert( addr < m_words );
+
+	m_log.push_back( std::make_pair(addr, value.m_value & mask()) );
+	c->m_sim->post(this);
+    }
+
+    // applies the write log, marking the words that changed
+    virtual bool update()
+    {
+	if(m_log.empty())
+	    return false;
+
+	for(int i = 0; i < m_log.size(); i++)
+	{
+	    uint64_t addr = m_log[i].first, value = m_log[i].second;
+
+	    if(m_data[addr] == value)
+		continue;
+
+	    m_data[addr] = value;
+
+	    if(!word_changed(addr))
+	    {
+		m_dirtyMap[addr >> 6] |= 1ULL << (addr & 63);
+		m_dirty.push_back(addr);
+
+		if(m_traced && addr < m_traceWords)
+		    m_traceChanges.push_back(addr);
+	    }
+	}
+
+	TRACE("update memory %s [%d writes] \n", name().c_str(), (int) m_log.size());
+
+	m_log.clear();
+	return true;
+    }
+
+    // some word changed in the last commit
+    virtual bool changed() const
+    {
+	return !m_dirty.empty();
+    }
+
+    bool word_changed( uint64_t addr ) const
+    {
+	return (m_dirtyMap[addr >> 6] >> (addr & 63)) & 1;
+    }
+
+    // words changed in the last commit
+    const std::vector<uint64_t>& dirty_words() const
+    {
+	return m_dirty;
+    }
+
+    virtual void clear_changed()
+    {
+	BOOST_FOREACH(uint64_t addr, m_dirty)
+	    m_dirtyMap[addr >> 6] = 0;
+	m_dirty.clear();
+    }
+
+    // blocks c until word addr changes
+    void wait_word( Context *c, uint64_t addr )
+    {
+	do
+	{
+	    c->wait_signal(*this);
+	} while(!word_changed(addr));
+    }
+
+    // observers see the most recently changed address
+    virtual uint64_t raw_value() const
+    {
+	return m_dirty.empty() ? 0 : m_dirty.back();
+    }
+
+    /**
+     * Function load()
+     * Backdoor preload, bypassing the write log and waking no process.
+     * The file holds one native uint64_t per word (bits above the width
+     * must be 0) and is mapped copy-on-write at first_word when that is
+     * page aligned, copied otherwise. Returns false on I/O errors or if the
+     * image does not fit.
+     */
+    bool load( const std::string filename, uint64_t first_word = 0 );
+
+    /**
+     * Function take_trace_changes()
+     * Moves the traced words changed since the last call to words (used by
+     * VCDWriter, which only dumps changed words).
+     */
+    void take_trace_changes( std::vector<uint64_t>& words )
+    {
+	words.swap(m_traceChanges);
+	m_traceChanges.clear();
+    }
+
+    int m_bits;
+    uint64_t m_words;
+    uint64_t *m_data;
+    size_t m_mapSize;
+
+    std::vector< std::pair<uint64_t, uint64_t> > m_log;
+    std::vector<uint64_t> m_dirty;
+    std::vector<uint64_t> m_dirtyMap;
+
+    // words [0, m_traceWords) appear in VCD files
+    uint64_t m_traceWords;
+    bool m_traced;
+    std::vector<uint64_t> m_traceChanges;
+};
+
+#endif
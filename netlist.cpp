@@ -0,0 +1,262 @@
+#include <algorithm>
+
+#include "netlist.h"
+
+const int Netlist::c_zero;
+const int Netlist::c_one;
+const int Netlist::c_undriven;
+const int Netlist::c_source;
+
+Netlist::Netlist() : m_levels( 0 ), m_clock( NULL )
+{
+    add_net();
+    add_net();
+
+    m_driver[c_zero] = m_driver[c_one] = c_source;
+    m_nets[c_one] = ~0ULL;
+}
+
+int Netlist::add_net()
+{
+    m_nets.push_back(0);
+    m_driver.push_back(c_undriven);
+    return m_nets.size() - 1;
+}
+
+int Netlist::add_input( Logic *sig, int bit )
+{
+    Boundary b = { sig, bit, add_net(), -1 };
+
+    m_driver[b.m_net] = c_source;
+    if(sig)
+	m_inputs.push_back(b);
+    return b.m_net;
+}
+
+void Netlist::add_output( int net, Logic *sig, int bit )
+{
+    Boundary b = { sig, bit, net, -1 };
+
+    for(int i = 0; i < m_outputSignals.size(); i++)
+	if(m_outputSignals[i] == sig)
+	    b.m_index = i;
+
+    if(b.m_index < 0)
+    {
+	b.m_index = m_outputSignals.size();
+	m_outputSignals.push_back(sig);
+	m_outputValues.push_back(0);
+    }
+
+    m_outputs.push_back(b);
+}
+
+int Netlist::add_gate( GateType type, int a, int b, int s, int out )
+{
+    if(out < 0)
+	out = add_net();
+
+    m_driver[out] = m_type.size();
+
+    // unused inputs read the constant 0
+    m_type.push_back(type);
+    m_a.push_back(a);
+    m_b.push_back(b < 0 ? c_zero : b);
+    m_s.push_back(s < 0 ? c_zero : s);
+    m_out.push_back(out);
+    return out;
+}
+
+int Netlist::add_dff( bool init )
+{
+    int q = add_net();
+
+    m_driver[q] = c_source;
+    m_nets[q] = init ? ~0ULL : 0;
+    m_q.push_back(q);
+    m_d.push_back(-1);
+    return q;
+}
+
+void Netlist::set_d( int q, int d )
+{
+    for(int i = 0; i < m_q.size(); i++)
+	if(m_q[i] == q)
+	    m_d[i] = d;
+}
+
+/*
+ Levels: inputs, constants and DFF outputs are level 0, a gate is one level
+ above its deepest input. Kahn's algorithm over the gate graph; gates left
+ over sit on a combinational loop.
+*/
+
+bool Netlist::build()
+{
+    int n = m_type.size();
+    std::vector<int> level(n, 1), pending(n, 0), order;
+    std::vector< std::vector<int> > readers( m_nets.size() );
+
+    for(int i = 0; i < m_d.size(); i++)
+	if(m_d[i] < 0 || m_driver[ m_d[i] ] == c_undriven)
+	    return false;
+
+    for(int g = 0; g < n; g++)
+    {
+	int in[3] = { m_a[g], m_b[g], m_s[g] };
+
+	for(int k = 0; k < 3; k++)
+	{
+	    if(m_driver[ in[k] ] == c_undriven)
+		return false;
+
+	    if(m_driver[ in[k] ] >= 0)
+	    {
+		readers[ in[k] ].push_back(g);
+		pending[g]++;
+	    }
+	}
+
+	if(!pending[g])
+	    order.push_back(g);
+    }
+
+    for(int i = 0; i < order.size(); i++)
+    {
+	int g = order[i];
+
+	BOOST_FOREACH(int r, readers[ m_out[g] ])
+	{
+	    level[r] = std::max( level[r], level[g] + 1 );
+	    if(!--pending[r])
+		order.push_back(r);
+	}
+    }
+
+    if(order.size() != n)
+	return false;
+
+    // by level, then by type: each (level, type) run is one loop in eval()
+    std::vector< std::pair<std::pair<int, int>, int> > keys;
+    for(int g = 0; g < n; g++)
+	keys.push_back( std::make_pair( std::make_pair(level[g], (int) m_type[g]), g ) );
+    std::sort( keys.begin(), keys.end() );
+
+    std::vector<uint8_t> type(n);
+    std::vector<int> a(n), b(n), s(n), out(n);
+
+    m_segments.clear();
+    m_levels = 0;
+
+    for(int i = 0; i < n; i++)
+    {
+	int g = keys[i].second;
+
+	type[i] = m_type[g];
+	a[i] = m_a[g];
+	b[i] = m_b[g];
+	s[i] = m_s[g];
+	out[i] = m_out[g];
+	m_driver[ out[i] ] = i;
+	m_levels = std::max( m_levels, level[g] );
+
+	if(i == 0 || keys[i].first != keys[i - 1].first)
+	{
+	    Segment seg = { (GateType) type[i], i, i };
+	    m_segments.push_back(seg);
+	}
+	m_segments.back().m_end = i + 1;
+    }
+
+    m_type.swap(type);
+    m_a.swap(a);
+    m_b.swap(b);
+    m_s.swap(s);
+    m_out.swap(out);
+    m_sampled.resize( m_q.size() );
+    return true;
+}
+
+void Netlist::eval()
+{
+    uint64_t *v = &m_nets[0];
+    const int *a = &m_a[0], *b = &m_b[0], *s = &m_s[0], *out = &m_out[0];
+
+    BOOST_FOREACH(const Segment& seg, m_segments)
+    {
+	int i = seg.m_begin, end = seg.m_end;
+
+	switch(seg.m_type)
+	{
+	    case AND:	for(; i < end; i++) v[out[i]] = v[a[i]] & v[b[i]]; break;
+	    case OR:	for(; i < end; i++) v[out[i]] = v[a[i]] | v[b[i]]; break;
+	    case XOR:	for(; i < end; i++) v[out[i]] = v[a[i]] ^ v[b[i]]; break;
+	    case NAND:	for(; i < end; i++) v[out[i]] = ~(v[a[i]] & v[b[i]]); break;
+	    case NOR:	for(; i < end; i++) v[out[i]] = ~(v[a[i]] | v[b[i]]); break;
+	    case XNOR:	for(; i < end; i++) v[out[i]] = ~(v[a[i]] ^ v[b[i]]); break;
+	    case NOT:	for(; i < end; i++) v[out[i]] = ~v[a[i]]; break;
+	    case BUF:	for(; i < end; i++) v[out[i]] = v[a[i]]; break;
+	    case MUX:	for(; i < end; i++) v[out[i]] = (v[a[i]] & ~v[s[i]]) | (v[b[i]] & v[s[i]]); break;
+	    default:	break;
+	}
+    }
+}
+
+void Netlist::clock()
+{
+    // all DFFs sample before any of them changes (shift registers)
+    for(int i = 0; i < m_q.size(); i++)
+	m_sampled[i] = m_nets[ m_d[i] ];
+
+    for(int i = 0; i < m_q.size(); i++)
+	m_nets[ m_q[i] ] = m_sampled[i];
+}
+
+void Netlist::sample_inputs()
+{
+    BOOST_FOREACH(const Boundary& b, m_inputs)
+	m_nets[b.m_net] = -( (b.m_sig->value() >> b.m_bit) & 1 );
+}
+
+void Netlist::drive_outputs( Context *c )
+{
+    for(int i = 0; i < m_outputValues.size(); i++)
+	m_outputValues[i] = 0;
+
+    BOOST_FOREACH(const Boundary& b, m_outputs)
+	m_outputValues[b.m_index] |= (m_nets[b.m_net] & 1) << b.m_bit;
+
+    for(int i = 0; i < m_outputSignals.size(); i++)
+	c->assign( *m_outputSignals[i], LogicValue( m_outputSignals[i]->m_bits, m_outputValues[i] ) );
+}
+
+int Netlist::process( Context *c )
+{
+    Netlist *n = static_cast<Netlist *>( c->m_arg );
+
+    for(;;)
+    {
+	if(n->m_clock && n->m_clock->pos_edge())
+	    n->clock();
+
+	n->sample_inputs();
+	n->eval();
+	n->drive_outputs(c);
+
+	c->wait_signal(n->m_sensitivity);
+    }
+    return 0;
+}
+
+void Netlist::attach( Simulation *sim, Logic *clk, const std::string name )
+{
+    m_clock = clk;
+    m_sensitivity.clear();
+
+    BOOST_FOREACH(const Boundary& b, m_inputs)
+	m_sensitivity.insert(b.m_sig);
+    if(clk)
+	m_sensitivity.insert(clk);
+
+    sim->add_process( process, name, false, this );
+}
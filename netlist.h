@@ -0,0 +1,146 @@
+#ifndef __NETLIST_H
+#define __NETLIST_H
+
+#include "sim.h"
+
+/*
+ Gate-level netlist engine: thousands of gates as one process.
+
+ Gates (AND/OR/XOR/NAND/NOR/XNOR/NOT/BUF/MUX) and DFFs are appended to flat
+ arrays; build() levelizes the combinational logic and sorts the gates by
+ level and type, so eval() is a few tight loops of word-wide operations with
+ no per-gate dispatch. Every net is a 64-bit word: bit k is the net's value
+ in pattern k, so 64 independent stimulus patterns go through the netlist
+ at once (pattern-parallel evaluation).
+
+ Inside a Simulation (attach()), the netlist is one process sensitive to its
+ boundary inputs and its clock. Inputs and outputs are bits of ordinary
+ Logic signals; a Logic input bit is broadcast to all 64 patterns and the
+ outputs take pattern 0. All DFFs share the netlist's clock and sample on
+ its rising edge.
+
+ Without a Simulation, set the input words with net(), call eval() and
+ clock() directly to run 64 patterns per pass.
+*/
+
+class Netlist
+{
+public:
+    enum GateType {
+	AND = 0,
+	OR,
+	XOR,
+	NAND,
+	NOR,
+	XNOR,
+	NOT,
+	BUF,
+	// out = s ? b : a, with the inputs (a, b, s)
+	MUX,
+	N_GATE_TYPES
+    };
+
+    // constant nets
+    static const int c_zero = 0;
+    static const int c_one = 1;
+
+    Netlist();
+
+    // a new net, to be driven by an input, a gate or a DFF
+    int add_net();
+
+    // a net driven by bit of sig; with no sig, a primary input set with net()
+    int add_input( Logic *sig = NULL, int bit = 0 );
+    // drives bit of sig from net
+    void add_output( int net, Logic *sig, int bit );
+
+    // returns the output net: out if given (a net from add_net()), else a new one
+    int add_gate( GateType type, int a, int b = -1, int s = -1, int out = -1 );
+
+    /**
+     * Function add_dff()
+     * Returns the Q net of a new DFF. Its D input is connected later with
+     * set_d(), so that feedback loops can be built.
+     */
+    int add_dff( bool init = false );
+    void set_d( int q, int d );
+
+    // levelizes the logic; false if it has a combinational loop or an undriven net
+    bool build();
+
+    // combinational logic, all 64 patterns
+    void eval();
+    // rising clock edge: every DFF loads its D
+    void clock();
+
+    uint64_t& net( int n )
+    {
+	return m_nets[n];
+    }
+
+    /**
+     * Function attach()
+     * Adds the netlist to sim as one process, clocked by clk (NULL if it
+     * has no DFFs). build() first.
+     */
+    void attach( Simulation *sim, Logic *clk, const std::string name );
+
+    int n_gates() const
+    {
+	return m_type.size();
+    }
+
+    int n_levels() const
+    {
+	return m_levels;
+    }
+
+private:
+    struct Boundary
+    {
+	Logic *m_sig;
+	int m_bit, m_net;
+	// outputs: index in m_outputSignals
+	int m_index;
+    };
+
+    // gates of one type on one level, [m_begin, m_end) in the sorted arrays
+    struct Segment
+    {
+	GateType m_type;
+	int m_begin, m_end;
+    };
+
+    static int process( Context *c );
+
+    void sample_inputs();
+    void drive_outputs( Context *c );
+
+    static const int c_undriven = -2;
+    static const int c_source = -1;
+
+    // per net
+    std::vector<uint64_t> m_nets;
+    // index of the gate driving the net; c_source for inputs, constants
+    // and DFF outputs, c_undriven for nets not connected yet
+    std::vector<int> m_driver;
+
+    // per gate, in creation order until build(), then by level and type
+    std::vector<uint8_t> m_type;
+    std::vector<int> m_a, m_b, m_s, m_out;
+    std::vector<Segment> m_segments;
+    int m_levels;
+
+    // per DFF
+    std::vector<int> m_q, m_d;
+    std::vector<uint64_t> m_sampled;
+
+    std::vector<Boundary> m_inputs, m_outputs;
+    std::vector<Logic *> m_outputSignals;
+    std::vector<uint64_t> m_outputValues;
+
+    Logic *m_clock;
+    std::set<SigBase *> m_sensitivity;
+};
+
+#endif
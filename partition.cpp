@@ -0,0 +1,394 @@
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include "partition.h"
+#include "vcd.h"
+
+ShmChannel::ShmChannel( const std::string name, bool create, int size_log2 ) :
+    SpscChannel( map_shm( name, create, ring_bytes(1 << size_log2) ), 1 << size_log2, create ),
+    m_shmName( name ), m_mapSize( ring_bytes(1 << size_log2) ), m_creator( create )
+{
+}
+
+void *ShmChannel::map_shm( const std::string& name, bool create, size_t bytes )
+{
+    int fd = shm_open( name.c_str(), create ? O_CREAT | O_RDWR | O_TRUNC : O_RDWR, 0600 );
+
+    if(fd < 0)
+	throw std::runtime_error("ShmChannel: can't open " + name);
+
+    if(create && ftruncate(fd, bytes) < 0)
+    {
+	close(fd);
+	throw std::runtime_error("ShmChannel: can't resize " + name);
+    }
+
+    struct stat st;
+
+    // mapping more than the creator made would SIGBUS past its end
+    if(!create && (fstat(fd, &st) < 0 || st.st_size != (off_t) bytes))
+    {
+	close(fd);
+	throw std::runtime_error("ShmChannel: " + name + " has another size than expected");
+    }
+
+    void *mem = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close(fd);
+
+    if(mem == MAP_FAILED)
+	throw std::runtime_error("ShmChannel: can't map " + name);
+
+    // only trust a ring its creator has finished setting up
+    if(!create && static_cast<Ring *>(mem)->m_ready.load( std::memory_order_acquire ) != Ring::c_magic)
+    {
+	munmap( mem, bytes );
+	throw std::runtime_error("ShmChannel: " + name + " is not initialized yet");
+    }
+
+    return mem;
+}
+
+ShmChannel::~ShmChannel()
+{
+    munmap( m_ring, m_mapSize );
+
+    if(m_creator)
+	shm_unlink( m_shmName.c_str() );
+}
+
+SocketChannel::~SocketChannel()
+{
+    close(m_fd);
+}
+
+void SocketChannel::create_pair( SocketChannel **tx, SocketChannel **rx )
+{
+    int fds[2];
+
+    if( socketpair( AF_UNIX, SOCK_SEQPACKET, 0, fds ) < 0 )
+	throw std::runtime_error("SocketChannel: socketpair() failed");
+
+    *tx = new SocketChannel(fds[0]);
+    *rx = new SocketChannel(fds[1]);
+}
+
+// a full or empty socket is worth retrying
+static bool retry( int err )
+{
+    return err == EAGAIN || err == EWOULDBLOCK || err == EINTR;
+}
+
+bool SocketChannel::send( const SyncMessage& msg )
+{
+    // seqpacket sockets never deliver partial messages
+    ssize_t n = ::send( m_fd, &msg, sizeof(msg), MSG_DONTWAIT | MSG_NOSIGNAL );
+
+    if(n == sizeof(msg))
+	return true;
+
+    if(n < 0 && retry(errno))
+	return false;
+
+    // the peer partition is gone, finished or not (the input side tells)
+    if(n < 0 && (errno == EPIPE || errno == ECONNRESET))
+    {
+	m_closed = true;
+	return true;
+    }
+
+    throw std::runtime_error( std::string("SocketChannel: send() failed: ") + strerror(errno) );
+}
+
+bool SocketChannel::receive( SyncMessage& msg )
+{
+    ssize_t n = ::recv( m_fd, &msg, sizeof(msg), MSG_DONTWAIT );
+
+    if(n == sizeof(msg))
+	return true;
+
+    if(n < 0 && retry(errno))
+	return false;
+
+    if(n == 0 || (n < 0 && errno == ECONNRESET))
+    {
+	m_closed = true;
+	return false;
+    }
+
+    if(n > 0)
+	throw std::runtime_error("SocketChannel: truncated message");
+
+    throw std::runtime_error( std::string("SocketChannel: recv() failed: ") + strerror(errno) );
+}
+
+void Partition::add_input( Logic *sig, SyncChannel *ch, int port )
+{
+    InputLink *link = NULL;
+
+    BOOST_FOREACH(InputLink& l, m_inputs)
+	if(l.m_channel == ch)
+	    link = &l;
+
+    if(!link)
+    {
+	m_inputs.push_back( InputLink() );
+	link = &m_inputs.back();
+	link->m_channel = ch;
+	link->m_horizon = 0;
+    }
+
+    if(link->m_ports.size() <= port)
+	link->m_ports.resize(port + 1, NULL);
+
+    link->m_ports[port] = sig;
+    m_sim.add_signal(sig);
+}
+
+void Partition::add_output( Logic *sig, SyncChannel *ch, int port )
+{
+    OutputLink *link = NULL;
+
+    BOOST_FOREACH(OutputLink& l, m_outputs)
+	if(l.m_channel == ch)
+	    link = &l;
+
+    if(!link)
+    {
+	m_outputs.push_back( OutputLink() );
+	link = &m_outputs.back();
+	link->m_channel = ch;
+	link->m_lastNull = -1;
+    }
+
+    if(link->m_ports.size() <= port)
+    {
+	link->m_ports.resize(port + 1, NULL);
+	link->m_lastSent.resize(port + 1, 0);
+    }
+
+    link->m_ports[port] = sig;
+    m_sim.add_signal(sig);
+}
+
+void Partition::poll_inputs()
+{
+    SyncMessage msg;
+
+    BOOST_FOREACH(InputLink& link, m_inputs)
+    {
+	while( link.m_channel->receive(msg) )
+	{
+	    if( msg.m_time > link.m_horizon )
+		link.m_horizon = msg.m_time;
+
+	    if( msg.m_kind == SyncMessage::VALUE )
+		link.m_pending.push_back(msg);
+	}
+
+	// a finished peer promised m_until with its last NULL message
+	if( link.m_channel->closed() && link.m_horizon < m_until )
+	    throw std::runtime_error("Partition " + m_name + ": an input partition died");
+    }
+}
+
+void Partition::send( OutputLink& link, const SyncMessage& msg )
+{
+    // keep draining our own inputs while the peer catches up, otherwise two
+    // partitions with full channels towards each other would never progress
+    while( !link.m_channel->send(msg) )
+    {
+	poll_inputs();
+	std::this_thread::yield();
+    }
+}
+
+void Partition::send_null( int64_t time )
+{
+    // nobody processes anything at or past m_until, no need to promise more
+    if( time > m_until )
+	time = m_until;
+
+    BOOST_FOREACH(OutputLink& link, m_outputs)
+    {
+	if( time <= link.m_lastNull )
+	    continue;
+
+	SyncMessage msg;
+	msg.m_time = time;
+	msg.m_port = 0;
+	msg.m_kind = SyncMessage::NULL_MSG;
+	msg.m_value = 0;
+
+	send(link, msg);
+	link.m_lastNull = time;
+    }
+}
+
+int64_t Partition::input_horizon() const
+{
+    int64_t h = Simulation::c_noEvent;
+
+    BOOST_FOREACH(const InputLink& link, m_inputs)
+	if( link.m_horizon < h )
+	    h = link.m_horizon;
+
+    return h;
+}
+
+int64_t Partition::earliest_pending() const
+{
+    int64_t t = Simulation::c_noEvent;
+
+    BOOST_FOREACH(const InputLink& link, m_inputs)
+	if( !link.m_pending.empty() && link.m_pending.front().m_time < t )
+	    t = link.m_pending.front().m_time;
+
+    return t;
+}
+
+void Partition::run( int64_t units )
+{
+    bool first = true;
+
+    m_until = units;
+
+    BOOST_FOREACH(OutputLink& link, m_outputs)
+	for(int i = 0; i < link.m_ports.size(); i++)
+	    link.m_lastSent[i] = link.m_ports[i] ? link.m_ports[i]->value() : 0;
+
+    // nothing we produce can be seen before the lookahead
+    send_null( m_lookahead );
+
+    m_sim.dump();
+
+    for(;;)
+    {
+	poll_inputs();
+	// updates and calls injected by other threads
+	m_sim.drain_inbox();
+
+	int64_t t = first ? 0 : std::min( m_sim.next_event_time(), earliest_pending() );
+	int64_t horizon = input_horizon();
+
+	if( t >= units )
+	{
+	    // done, but only once no input can still arrive before the end
+	    if( horizon >= units )
+		break;
+	}
+	else if( horizon > t )
+	{
+	    m_sim.m_time = t;
+	    if(m_sim.m_timeline)
+		m_sim.trace_time();
+
+	    BOOST_FOREACH(InputLink& link, m_inputs)
+	    {
+		while( !link.m_pending.empty() && link.m_pending.front().m_time == t )
+		{
+		    const SyncMessage& msg = link.m_pending.front();
+		    Logic *sig = link.m_ports[msg.m_port];
+
+		    m_sim.drive( sig, sig->make_driver( LogicValue(sig->m_bits, msg.m_value) ) );
+		    link.m_pending.pop_front();
+		}
+	    }
+
+	    TRACE("%-8d: partition %s runs\n", t, m_name.c_str());
+
+	    m_sim.run_step();
+	    first = false;
+
+	    m_sim.dump();
+
+	    BOOST_FOREACH(OutputLink& link, m_outputs)
+	    {
+		for(int i = 0; i < link.m_ports.size(); i++)
+		{
+		    Logic *sig = link.m_ports[i];
+
+		    if( !sig || sig->value() == link.m_lastSent[i] || t + m_lookahead >= units )
+			continue;
+
+		    SyncMessage msg;
+		    msg.m_time = t + m_lookahead;
+		    msg.m_port = i;
+		    msg.m_kind = SyncMessage::VALUE;
+		    msg.m_value = sig->value();
+
+		    send(link, msg);
+		    link.m_lastSent[i] = msg.m_value;
+		}
+	    }
+
+	    int64_t bound = std::min( std::min( m_sim.next_event_time(), earliest_pending() ), input_horizon() );
+	    send_null( bound + m_lookahead );
+	    continue;
+	}
+
+	// blocked on a neighbour: advertise how far we can promise, then wait
+	send_null( std::min(t, horizon) + m_lookahead );
+	std::this_thread::yield();
+    }
+
+    send_null( units );
+}
+
+
+PartitionedSimulation::~PartitionedSimulation()
+{
+    BOOST_FOREACH(Link& link, m_links)
+	delete link.m_channel;
+    BOOST_FOREACH(Partition *p, m_partitions)
+	delete p;
+}
+
+Partition *PartitionedSimulation::add_partition( const std::string name, int64_t lookahead )
+{
+    Partition *p = new Partition(name, lookahead);
+    m_partitions.push_back(p);
+    return p;
+}
+
+void PartitionedSimulation::connect( Partition *src, Logic *src_sig, Partition *dst, Logic *dst_sig )
+{
+    Link *link = NULL;
+
+    BOOST_FOREACH(Link& l, m_links)
+	if(l.m_src == src && l.m_dst == dst)
+	    link = &l;
+
+    if(!link)
+    {
+	Link l;
+	l.m_src = src;
+	l.m_dst = dst;
+	l.m_channel = new SpscChannel;
+	l.m_nPorts = 0;
+	m_links.push_back(l);
+	link = &m_links.back();
+    }
+
+    int port = link->m_nPorts++;
+
+    src->add_output(src_sig, link->m_channel, port);
+    dst->add_input(dst_sig, link->m_channel, port);
+}
+
+void PartitionedSimulation::run( int64_t units )
+{
+    std::vector<std::thread> threads;
+
+    BOOST_FOREACH(Partition *p, m_partitions)
+	threads.push_back( std::thread( &Partition::run, p, units ) );
+
+    BOOST_FOREACH(std::thread& t, threads)
+	t.join();
+}
@@ -0,0 +1,307 @@
+#ifndef __PARTITION_H
+#define __PARTITION_H
+
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <new>
+#include <cstdlib>
+
+#include "sim.h"
+
+/*
+ Partitioned simulation with conservative (Chandy-Misra) synchronization.
+
+ The design is split into Partitions, each owning a private Simulation kernel
+ (its own processes, local signals and timed waits) and running on its own
+ thread. Boundary signals are carried between partitions over point-to-point
+ SyncChannels. A value produced by partition A at time t becomes visible in
+ partition B at t + lookahead (A's minimum output latency, typically the
+ clock period of the boundary registers).
+
+ Each partition advances to its next event time T only when every input
+ channel guarantees that nothing earlier than or equal to T can still
+ arrive. Such guarantees are carried by the messages themselves (a value
+ message at time t promises that all later messages are >= t) and by NULL
+ messages, which a partition emits whenever its own lower bound for future
+ output improves. A strictly positive lookahead ensures progress.
+
+ Partitions do not need to share an address space: each process of a
+ distributed run builds its own Partition, marks its boundary signals as
+ remote with add_input()/add_output() over ShmChannels (or SocketChannels)
+ and calls Partition::run() with the same end time.
+*/
+
+struct SyncMessage
+{
+    enum Kind {
+	VALUE = 0,
+	NULL_MSG = 1
+    };
+
+    int64_t m_time;
+    int32_t m_port;
+    int32_t m_kind;
+    uint64_t m_value;
+};
+
+/**
+ * Class SyncChannel
+ * One-directional, FIFO-ordered message link between two partitions.
+ * Both calls are non-blocking. A transport that can tell that the other
+ * side is gone (SocketChannel) reports it with closed(); Partition::run()
+ * fails if that happens before the peer promised to send nothing more.
+ */
+class SyncChannel
+{
+public:
+    virtual ~SyncChannel() {}
+
+    // returns false if the channel is full
+    virtual bool send( const SyncMessage& msg ) = 0;
+    // returns false if there is nothing to receive
+    virtual bool receive( SyncMessage& msg ) = 0;
+
+    // the other side is gone, nothing more will arrive
+    virtual bool closed() const
+    {
+	return false;
+    }
+};
+
+/**
+ * Class SpscChannel
+ * Lock-free single-producer/single-consumer ring buffer, for partitions
+ * running as threads of one process.
+ */
+class SpscChannel : public SyncChannel
+{
+public:
+    SpscChannel( int size_log2 = 12 )
+    {
+	size_t size = 1 << size_log2;
+
+	attach( aligned_alloc( 64, (ring_bytes(size) + 63) & ~63 ), size, true );
+	m_ownsRing = true;
+    }
+
+    ~SpscChannel()
+    {
+	if(m_ownsRing)
+	    free( m_ring );
+    }
+
+    bool send( const SyncMessage& msg )
+    {
+	uint64_t tail = m_ring->m_tail.load( std::memory_order_relaxed );
+
+	if( tail - m_ring->m_head.load( std::memory_order_acquire ) == m_ring->m_size )
+	    return false;
+
+	m_msgs[ tail & (m_ring->m_size - 1) ] = msg;
+	m_ring->m_tail.store( tail + 1, std::memory_order_release );
+	return true;
+    }
+
+    bool receive( SyncMessage& msg )
+    {
+	uint64_t head = m_ring->m_head.load( std::memory_order_relaxed );
+
+	if( head == m_ring->m_tail.load( std::memory_order_acquire ) )
+	    return false;
+
+	msg = m_msgs[ head & (m_ring->m_size - 1) ];
+	m_ring->m_head.store( head + 1, std::memory_order_release );
+	return true;
+    }
+
+protected:
+    // ring header; the messages follow it in the same block of memory,
+    // which may be shared between processes
+    struct Ring
+    {
+	static const uint64_t c_magic = 0x474e495243535053ULL;	// "SPSCRING"
+
+	// consumer and producer indices live on separate cache lines
+	alignas(64) std::atomic<uint64_t> m_head;
+	alignas(64) std::atomic<uint64_t> m_tail;
+	alignas(64) uint64_t m_size;
+	// c_magic once the creator has set up the rest (release/acquire)
+	std::atomic<uint64_t> m_ready;
+    };
+
+    // wraps an externally owned (e.g. shared) block of ring_bytes(size) bytes
+    SpscChannel( void *mem, size_t size, bool init ) : m_ownsRing( false )
+    {
+	attach( mem, size, init );
+    }
+
+    static size_t ring_bytes( size_t size )
+    {
+	return sizeof(Ring) + size * sizeof(SyncMessage);
+    }
+
+    void attach( void *mem, size_t size, bool init )
+    {
+	m_ring = reinterpret_cast<Ring *>( mem );
+	m_msgs = reinterpret_cast<SyncMessage *>( m_ring + 1 );
+
+	if(init)
+	{
+	    new (m_ring) Ring;
+	    m_ring->m_head.store(0);
+	    m_ring->m_tail.store(0);
+	    m_ring->m_size = size;
+	    m_ring->m_ready.store( Ring::c_magic, std::memory_order_release );
+	}
+    }
+
+    Ring *m_ring;
+    SyncMessage *m_msgs;
+    bool m_ownsRing;
+};
+
+/**
+ * Class ShmChannel
+ * SpscChannel living in a POSIX shared memory object, for partitions running
+ * as separate processes on the same host. The creating side sets up (and
+ * on destruction unlinks) the object, the other side opens it by name, with
+ * the same size_log2, once the creator's constructor has returned. A channel
+ * created before fork() can be used directly by both processes.
+ */
+class ShmChannel : public SpscChannel
+{
+public:
+    ShmChannel( const std::string name, bool create, int size_log2 = 12 );
+    ~ShmChannel();
+
+private:
+    static void *map_shm( const std::string& name, bool create, size_t bytes );
+
+    std::string m_shmName;
+    size_t m_mapSize;
+    bool m_creator;
+};
+
+/**
+ * Class SocketChannel
+ * Local (AF_UNIX, SOCK_SEQPACKET) socket transport, interchangeable with
+ * ShmChannel. Mostly useful for testing and debugging the protocol.
+ */
+class SocketChannel : public SyncChannel
+{
+public:
+    SocketChannel( int fd ) : m_fd( fd ), m_closed( false ) {}
+    ~SocketChannel();
+
+    // creates a connected pair: messages sent to *tx are received from *rx
+    static void create_pair( SocketChannel **tx, SocketChannel **rx );
+
+    // once the peer is gone, sends are dropped (nobody is left to read
+    // them) and receives come back empty; other errors throw
+    bool send( const SyncMessage& msg );
+    bool receive( SyncMessage& msg );
+
+    bool closed() const
+    {
+	return m_closed;
+    }
+
+private:
+    int m_fd;
+    bool m_closed;
+};
+
+
+class Partition
+{
+public:
+    Partition( const std::string name, int64_t lookahead ) :
+	m_name( name ), m_lookahead( lookahead )
+    {
+	assert( lookahead > 0 );
+    }
+
+    /**
+     * Function add_input()
+     * Makes sig (a signal local to this partition) follow the values arriving
+     * on the given port of channel ch.
+     */
+    void add_input( Logic *sig, SyncChannel *ch, int port );
+
+    /**
+     * Function add_output()
+     * Publishes every change of sig on the given port of channel ch.
+     */
+    void add_output( Logic *sig, SyncChannel *ch, int port );
+
+    // simulates the partition up to (not including) time units
+    void run( int64_t units );
+
+    Simulation m_sim;
+    std::string m_name;
+    int64_t m_lookahead;
+
+private:
+    struct InputLink
+    {
+	SyncChannel *m_channel;
+	std::vector<Logic *> m_ports;
+	std::deque<SyncMessage> m_pending;
+	int64_t m_horizon;
+    };
+
+    struct OutputLink
+    {
+	SyncChannel *m_channel;
+	std::vector<Logic *> m_ports;
+	std::vector<uint64_t> m_lastSent;
+	int64_t m_lastNull;
+    };
+
+    void poll_inputs();
+    void send( OutputLink& link, const SyncMessage& msg );
+    void send_null( int64_t time );
+
+    int64_t input_horizon() const;
+    int64_t earliest_pending() const;
+
+    std::vector<InputLink> m_inputs;
+    std::vector<OutputLink> m_outputs;
+    int64_t m_until;
+};
+
+/**
+ * Class PartitionedSimulation
+ * Runs a set of partitions, one thread each, connected by SpscChannels.
+ */
+class PartitionedSimulation
+{
+public:
+    ~PartitionedSimulation();
+
+    Partition *add_partition( const std::string name, int64_t lookahead );
+
+    /**
+     * Function connect()
+     * Carries src_sig (in partition src) to dst_sig (in partition dst) with
+     * the lookahead of src.
+     */
+    void connect( Partition *src, Logic *src_sig, Partition *dst, Logic *dst_sig );
+
+    void run( int64_t units );
+
+    std::vector<Partition *> m_partitions;
+
+private:
+    struct Link
+    {
+	Partition *m_src, *m_dst;
+	SpscChannel *m_channel;
+	int m_nPorts;
+    };
+
+    std::vector<Link> m_links;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __PROBES_H
+#define __PROBES_H
+
+/*
+ USDT probes for perf, bpftrace and systemtap, compiled in with -DSIM_USDT
+ (make USDT=1 or PROFILE=1; needs sys/sdt.h from systemtap-sdt-dev):
+
+    sim:process_resume( name, slot, time )	a process is about to run
+    sim:process_yield( name, slot, time )	it is back in the scheduler
+    sim:signal_commit( name, id, value, time )	a signal changed
+    sim:time_advance( time )			the next time step
+
+ name is a C string, slot the process' index in Simulation::m_ctxs, id the
+ signal's m_id. Every probe has a semaphore that the tracer raises while it
+ is attached, so the arguments (the signal name lookup in particular) are
+ only computed when somebody listens, e.g.
+
+    bpftrace -e 'usdt:./test_counter:sim:process_resume { @[str(arg0)] = count(); }'
+    perf probe -x ./test_counter sdt_sim:process_resume
+
+ The probes fire from sim.cpp only, which defines the semaphores with
+ SIM_PROBE_SEMAPHORES. Without SIM_USDT, SIM_PROBE() expands to nothing.
+*/
+
+#ifdef SIM_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define SIM_PROBE_SEMAPHORE(name) \
+    __extension__ volatile unsigned short sim_##name##_semaphore \
+	__attribute__ ((unused)) __attribute__ ((section (".probes"))) __attribute__ ((visibility ("hidden")))
+
+#define SIM_PROBE_SEMAPHORES \
+    SIM_PROBE_SEMAPHORE(process_resume); \
+    SIM_PROBE_SEMAPHORE(process_yield); \
+    SIM_PROBE_SEMAPHORE(signal_commit); \
+    SIM_PROBE_SEMAPHORE(time_advance)
+
+// the probe's argument count picks the STAP_PROBEn
+#define SIM_PROBE_N(_1, _2, _3, _4, n, ...) STAP_PROBE##n
+#define SIM_PROBE(name, ...) \
+    do { \
+	if(__builtin_expect( sim_##name##_semaphore, 0 )) \
+	    SIM_PROBE_N(__VA_ARGS__, 4, 3, 2, 1)( sim, name, __VA_ARGS__ ); \
+    } while(0)
+
+#else
+
+#define SIM_PROBE_SEMAPHORES
+#define SIM_PROBE(name, ...) do {} while(0)
+
+#endif
+
+#endif
@@ -0,0 +1,124 @@
+#include "replay.h"
+
+Replay::Replay( Simulation *sim, const std::string recording, const std::vector<Logic *>& clocks,
+		const std::vector<Logic *>& inputs ) :
+    m_sim( sim ), m_hasNext( false ), m_end( 0 ), m_compare( NULL )
+{
+    if(!m_reader.open(recording))
+    {
+	m_error = recording + ": " + m_reader.m_error;
+	return;
+    }
+
+    m_inputs.resize( m_reader.n_codes() );
+
+    BOOST_FOREACH(Logic *l, clocks)
+	if(!add_input(l, true))
+	    return;
+    BOOST_FOREACH(Logic *l, inputs)
+	if(!add_input(l, false))
+	    return;
+
+    // the first timestamp holds the initial values
+    m_hasNext = m_reader.next(m_next);
+    m_end = m_hasNext ? m_next.m_time : 0;
+
+    for(int64_t first = m_end; m_hasNext && m_next.m_time == first; m_hasNext = m_reader.next(m_next))
+	if(m_next.m_code >= 0)
+	    BOOST_FOREACH(const Input& in, m_inputs[m_next.m_code])
+		in.m_sig->initial( LogicValue( in.m_sig->m_bits, m_next.m_value ) );
+
+    m_compare = new WaveCompare( sim, recording );
+    if(!m_compare->ok())
+    {
+	m_error = m_compare->m_error;
+	return;
+    }
+    m_unmatched = m_compare->m_unmatched;
+
+    sim->add_process( process, "replay", false, this );
+}
+
+Replay::~Replay()
+{
+    delete m_compare;
+}
+
+bool Replay::add_input( Logic *l, bool clock )
+{
+    int code = m_reader.find( l->name() );
+
+    if(code < 0)
+    {
+	m_error = l->name() + ": not in the recording";
+	return false;
+    }
+
+    BOOST_FOREACH(const VCDReader::Var& v, m_reader.m_vars)
+	if(v.m_code == code && v.m_bits != l->m_bits)
+	{
+	    m_error = l->name() + ": width differs";
+	    return false;
+	}
+
+    Input in = { l, clock };
+    m_inputs[code].push_back(in);
+    return true;
+}
+
+int Replay::process( Context *c )
+{
+    Replay *r = static_cast<Replay *>( c->m_arg );
+    int64_t at = r->m_end;
+
+    while(r->m_hasNext)
+    {
+	int64_t stamp = r->m_next.m_time;
+
+	if(at > c->m_sim->m_time)
+	    c->wait( at - c->m_sim->m_time );
+
+	bool edge = false;
+
+	for(; r->m_hasNext && r->m_next.m_time == stamp; r->m_hasNext = r->m_reader.next(r->m_next))
+	{
+	    if(r->m_next.m_code < 0)
+		continue;
+
+	    BOOST_FOREACH(const Input& in, r->m_inputs[r->m_next.m_code])
+	    {
+		if(!in.m_clock)
+		{
+		    r->m_pending.push_back( std::make_pair( in.m_sig, r->m_next.m_value ) );
+		    continue;
+		}
+
+		LogicValue v( in.m_sig->m_bits, r->m_next.m_value );
+
+		if(!in.m_sig->equals(v))
+		{
+		    c->assign( *in.m_sig, v );
+		    edge = true;
+		}
+	    }
+	}
+
+	// the next delta: the block has seen the clocks
+	if(edge && !r->m_pending.empty())
+	    c->wait(0);
+
+	for(int i = 0; i < r->m_pending.size(); i++)
+	{
+	    Logic *l = r->m_pending[i].first;
+	    c->assign( *l, LogicValue( l->m_bits, r->m_pending[i].second ) );
+	}
+	r->m_pending.clear();
+
+	at = r->m_end = stamp;
+    }
+
+    if(!r->m_reader.m_error.empty())
+	r->m_error = r->m_reader.m_error;
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+#ifndef __REPLAY_H
+#define __REPLAY_H
+
+#include "sim.h"
+#include "vcdreader.h"
+#include "wavecmp.h"
+
+/*
+ Replay of one block from a recording of its boundary.
+
+ A run of the whole design records the block's inputs and outputs (a
+ VCDWriter restricted to those signals). Later, only the block's processes
+ are registered in a fresh Simulation, together with a Replay: it drives
+ the inputs from the recording and compares everything else it can match
+ by name - the outputs - with a WaveCompare, which reports the first
+ divergence and stops the run. The rest of the design is not simulated.
+
+ VCDWriter dumps the values settled in a time step under the time of the
+ following step (see Simulation::run()), so each timestamp's changes are
+ driven at the previous timestamp: the block sees its inputs change in the
+ same time steps as in the recorded run. The values of the first timestamp
+ become the inputs' initial values.
+
+ A dump does not keep the delta cycles. Clocks are driven first and the
+ other inputs one delta later, as if the rest of the design produced them
+ from registers: the block samples its data inputs from before the edge.
+*/
+
+class Replay
+{
+public:
+    // clocks and (other) inputs: driven from the recording, matched by name
+    Replay( Simulation *sim, const std::string recording, const std::vector<Logic *>& clocks,
+	    const std::vector<Logic *>& inputs );
+    ~Replay();
+
+    bool ok() const
+    {
+	return m_error.empty();
+    }
+
+    bool diverged() const
+    {
+	return m_compare && m_compare->failed();
+    }
+
+    // the first output that differed from the recording
+    const WaveMismatch& divergence() const
+    {
+	return m_compare->m_mismatch;
+    }
+
+    // time of the last change in the recording, once the replay got there
+    int64_t end_time() const
+    {
+	return m_end;
+    }
+
+    // recorded variables that match no signal, with the reason
+    std::vector<std::string> m_unmatched;
+    std::string m_error;
+
+private:
+    static int process( Context *c );
+    bool add_input( Logic *l, bool clock );
+
+    Simulation *m_sim;
+    VCDReader m_reader;
+    VCDReader::Change m_next;
+    bool m_hasNext;
+    int64_t m_end;
+
+    struct Input
+    {
+	Logic *m_sig;
+	bool m_clock;
+    };
+
+    // inputs per identifier code
+    std::vector< std::vector<Input> > m_inputs;
+    // data input changes of the current timestamp, driven after the clocks
+    std::vector< std::pair<Logic *, uint64_t> > m_pending;
+    WaveCompare *m_compare;
+};
+
+#endif
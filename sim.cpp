@@ -1,32 +1,238 @@
+#include <time.h>
+#include <algorithm>
+#include <sched.h>
+#include <mutex>
+#include <unordered_map>
+
 #include "sim.h"
 #include "vcd.h"
+#include "telemetry.h"
+#include "wavecmp.h"
+#include "timeline.h"
+#include "probes.h"
+
+std::atomic<int> SigBase::m_staticSigId(0);
+
+SIM_PROBE_SEMAPHORES;
+
+// names of the named signals by ID; function statics, as signals are often
+// globals constructed before this file's statics
+static std::mutex& name_lock()
+{
+    static std::mutex lock;
+    return lock;
+}
+
+static std::unordered_map<int, std::string>& name_table()
+{
+    static std::unordered_map<int, std::string> names;
+    return names;
+}
+
+const std::string& SigBase::name() const
+{
+    static const std::string unnamed("?");
+
+    if(!(m_flags & NAMED))
+	return unnamed;
+
+    std::lock_guard<std::mutex> guard( name_lock() );
+    return name_table()[m_id];
+}
+
+void SigBase::set_name( const std::string& name )
+{
+    std::lock_guard<std::mutex> guard( name_lock() );
 
-int SigBase::m_staticSigId = 0;
+    if(name == "?")
+    {
+	name_table().erase(m_id);
+	m_flags &= ~NAMED;
+    } else {
+	name_table()[m_id] = name;
+	m_flags |= NAMED;
+    }
+}
 
 
-void Simulation::add_process( int (*proc)(Context *), const std::string name, bool continuous )
+Context *Simulation::add_process( int (*proc)(Context *), const std::string name, bool continuous, void *arg )
 {
     Context *ctx = new Context;
     ctx->m_state = continuous ? Context::CONTINUOUS : Context::IDLE;
     ctx->m_cofunc = COROUTINE<int, Context*> (proc);
     ctx->m_sim = this;
     ctx->m_name = name;
+    ctx->m_arg = arg;
+    ctx->m_slot = m_ctxs.size();
     m_ctxs.push_back(ctx);
+    return ctx;
+}
+
+Process Simulation::spawn( int (*proc)(Context *), const std::string name, void *arg )
+{
+    Context *ctx;
+
+    if(!m_pool.empty())
+    {
+	ctx = m_pool.back();
+	m_pool.pop_back();
+    } else {
+	ctx = new Context;
+	ctx->m_sim = this;
+	ctx->m_pooled = true;
+    }
+
+    // keeps the stack, only the entry point changes
+    ctx->m_cofunc = COROUTINE<int, Context*> (proc);
+    ctx->m_name = name;
+    ctx->m_arg = arg;
+    ctx->m_run++;
+    // not run by the process loop until started
+    ctx->m_state = Context::SUSPENDED;
+    m_spawned.push_back(ctx);
+
+    Process p = { ctx, ctx->m_run };
+    return p;
 }
 
+void Simulation::retire( Context *ctx )
+{
+    ctx->m_state = Context::DONE;
+    // drops its armed timers, if any
+    ctx->m_timerGen++;
+    ctx->m_wait_signals.clear();
+
+    BOOST_FOREACH(Context *joiner, ctx->m_joiners)
+	if(joiner->m_state == Context::SUSPENDED)
+	    wake(joiner);
+    ctx->m_joiners.clear();
 
-void Simulation::run(int64_t units)
+    m_pool.push_back(ctx);
+}
+
+// puts the processes spawned since the last call into their m_ctxs slots
+static void start_spawned( Simulation *sim )
 {
-    if(m_writer)
-	m_writer->dump_signals();
+    BOOST_FOREACH(Context *ctx, sim->m_spawned)
+    {
+	if(ctx->m_slot < 0)
+	{
+	    ctx->m_slot = sim->m_ctxs.size();
+	    sim->m_ctxs.push_back(ctx);
+	}
+
+	ctx->m_state = Context::IDLE;
+	sim->m_woken++;
+    }
+
+    sim->m_spawned.clear();
+}
+
+// event-driven stand-ins for the cycle-based process kinds
+
+static int clock_stub(Context *c)
+{
+    Logic& clk = *c->m_cycle->m_clock;
+
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait( c->m_cycle->m_halfPeriod );
+    }
+    return 0;
+}
+
+static int clocked_stub(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge( *c->m_cycle->m_clock );
+	c->m_cycle->m_body(c);
+    }
+    return 0;
+}
+
+static int comb_stub(Context *c)
+{
+    for(;;)
+    {
+	c->m_cycle->m_body(c);
+	c->wait_signal( c->m_cycle->m_sensitivity );
+    }
+    return 0;
+}
+
+void Simulation::add_clock( Logic *clk, int64_t half_period )
+{
+    CycleProcess *p = new CycleProcess;
+
+    p->m_body = NULL;
+    p->m_clock = clk;
+    p->m_halfPeriod = half_period;
+    p->m_ctx = add_process( clock_stub, "clock:" + clk->name(), false );
+    p->m_ctx->m_cycle = p;
+    m_clocks.push_back(p);
+}
+
+void Simulation::add_clocked_process( int (*proc)(Context *), Logic *clk, const std::string name, void *arg )
+{
+    CycleProcess *p = new CycleProcess;
+
+    p->m_body = proc;
+    p->m_clock = clk;
+    p->m_halfPeriod = 0;
+    p->m_ctx = add_process( clocked_stub, name, false, arg );
+    p->m_ctx->m_cycle = p;
+    m_clocked.push_back(p);
+}
+
+void Simulation::add_comb_process( int (*proc)(Context *), const std::set<SigBase *>& sensitivity,
+				   const std::string name, void *arg )
+{
+    CycleProcess *p = new CycleProcess;
+
+    p->m_body = proc;
+    p->m_clock = NULL;
+    p->m_halfPeriod = 0;
+    p->m_sensitivity = sensitivity;
+    p->m_ctx = add_process( comb_stub, name, false, arg );
+    p->m_ctx->m_cycle = p;
+    m_comb.push_back(p);
+}
+
+
+void Simulation::run(int64_t units, EngineMode mode)
+{
+    if(mode == CYCLE_BASED)
+    {
+	run_cycles(units);
+	return;
+    }
+
+    dump();
 
-    while(m_time < units)
+    for(;;)
     {
+	poll_inbox(units);
+
+	if(m_time >= units || m_stopped)
+	    break;
+
 	step();
-	if(m_writer)
-	    m_writer->dump_signals();
+	dump();
     }
 
+    // nothing more to wait for
+    if(m_lockstep)
+	m_reached.store( c_noEvent, std::memory_order_release );
+}
+
+void Simulation::dump()
+{
+    if(m_writer)
+	m_writer->dump_signals();
+    if(m_compare)
+	m_compare->check();
 }
 
 /*
@@ -43,9 +249,28 @@ or active processes.
 
 */
 
+// runs a process until it yields, as a slice of the timeline when tracing
+static inline void resume( Simulation *sim, Context *ctx )
+{
+    SIM_PROBE( process_resume, ctx->m_name.c_str(), ctx->m_slot, sim->m_time );
+
+    if(!sim->m_tracing)
+	ctx->eval();
+    else {
+	int name = sim->m_timeline->resume( ctx, sim->m_time );
+	ctx->eval();
+	sim->m_timeline->yield( name, sim->m_time );
+    }
+
+    SIM_PROBE( process_yield, ctx->m_name.c_str(), ctx->m_slot, sim->m_time );
+}
+
 bool Simulation::do_contexts(bool signals_changed)
 {
-    std::set<SigBase *> processed_events;
+	m_woken = 0;
+
+	// spawned from outside of a process
+	start_spawned(this);
 
 	BOOST_FOREACH(Context *ctx, m_ctxs)
 	{
@@ -57,7 +282,7 @@ bool Simulation::do_contexts(bool signals_changed)
 		case Context::IDLE:
         	    TRACE("%-8d: run %s state %d wu %lld\n", m_time, ctx->m_name.c_str(), ctx->m_state );
 
-		    ctx->eval();
+		    resume(this, ctx);
 		    break;
 
 		case Context::WAITING_TIME:
@@ -66,7 +291,8 @@ bool Simulation::do_contexts(bool signals_changed)
             		TRACE("%-8d: resume_wait %s state %d wu %lld\n", m_time, ctx->m_name.c_str(), ctx->m_state, ctx->m_wait_until );
 
 			ctx->m_state == Context::IDLE;
-			ctx->eval();
+			ctx->m_timerGen++;
+			resume(this, ctx);
 		    }
 		    break;
 	    
@@ -79,7 +305,6 @@ bool Simulation::do_contexts(bool signals_changed)
 			if(sig->changed())
 			{
 			    trigger = sig;
-			    processed_events.insert(trigger);
 			    break;
 			}
 
@@ -89,9 +314,18 @@ bool Simulation::do_contexts(bool signals_changed)
 
         	    if(trigger)
 		    {
-			TRACE("%-8d: resume_event %s state %d trigger %s\n", m_time, ctx->m_name.c_str(),  ctx->m_state, trigger->m_name.c_str() );
+			TRACE("%-8d: resume_event %s state %d trigger %s\n", m_time, ctx->m_name.c_str(),  ctx->m_state, trigger->name().c_str() );
 			ctx->m_state == Context::IDLE;
-			ctx->eval();
+			ctx->m_wakeReason = Context::WAKE_SIGNAL;
+			ctx->m_trigger = trigger;
+			// cancels the timeout, if any
+			ctx->m_timerGen++;
+			resume(this, ctx);
+		    } else if(ctx->m_hasTimeout && m_time >= ctx->m_wait_until) {
+			TRACE("%-8d: timeout %s\n", m_time, ctx->m_name.c_str() );
+			ctx->m_wakeReason = Context::WAKE_TIMEOUT;
+			ctx->m_timerGen++;
+			resume(this, ctx);
 		    }
 		}
 		break;
@@ -103,74 +337,579 @@ bool Simulation::do_contexts(bool signals_changed)
 //    	    printf("Do context %p state %d wu %lld\n", ctx, ctx->m_state, ctx->m_wait_until);
 	}
 
-	BOOST_FOREACH(SigBase *sig, processed_events)
-	    sig->clear_changed();
+	// m_ctxs may grow now; the new processes run in the next delta
+	start_spawned(this);
+
+	// every process had its chance to see the last commit
+	clear_committed();
 
+	return true;
 }
 
-void Simulation::step()
+void Simulation::clear_committed()
+{
+    BOOST_FOREACH(SigBase *sig, m_committed)
+	sig->clear_changed();
+    m_committed.clear();
+}
+
+bool Simulation::commit()
+{
+    bool signals_changed = false;
+    // nobody observes changes: no snapshot, no per-signal test
+    bool observed = m_callbackSignals || m_recordChanges;
+
+    // the observers get the values from before all of this delta's updates
+    if(observed)
+    {
+	m_oldValues.resize( m_pendingSignals.size() );
+	for(int i = 0; i < m_pendingSignals.size(); i++)
+	{
+	    SigBase *sig = m_pendingSignals[i];
+	    m_oldValues[i] = (sig->m_callbacks || m_recordChanges) ? sig->raw_value() : 0;
+	}
+    }
+
+    // in assignment order, the last one wins
+    BOOST_FOREACH(const Update& u, m_updates)
+    {
+	if(u.m_driver)
+	{
+	    u.m_sig->copy_value( u.m_driver );
+	    delete u.m_driver;
+	} else {
+	    static_cast<Logic *>( u.m_sig )->apply( u.m_value );
+	}
+    }
+    m_updates.clear();
+
+    for(int i = 0; i < m_pendingSignals.size(); i++)
+    {
+	SigBase *sig = m_pendingSignals[i];
+
+	sig->m_flags &= ~SigBase::POSTED;
+
+	if(!sig->update())
+	    continue;
+
+	if(sig->changed())
+	{
+	    signals_changed = true;
+	    m_committed.push_back(sig);
+	    m_events++;
+
+	    if(m_tracing)
+		m_timeline->commit( sig, m_time );
+	    SIM_PROBE( signal_commit, sig->name().c_str(), sig->m_id, sig->raw_value(), m_time );
+
+	    if(observed && (sig->m_callbacks || m_recordChanges))
+		notify_change(sig, m_oldValues[i]);
+	}
+    }
+
+    m_pendingSignals.clear();
+    return signals_changed;
+}
+
+void Simulation::settle()
 {
     m_delta = 0;
 
+    bool changed;
 
     do {
-        bool signals_changed = false;
-
 	m_delta++;
+	m_deltas++;
+
+	if(m_tracing)
+	    m_timeline->delta_begin( m_time, m_delta );
 
 	do_contexts(true);
+	changed = commit();
+
+	if(!m_deltaEvents.empty())
+	    fire_delta_events();
+
+	if(m_tracing)
+	    m_timeline->delta_end( m_time, m_delta );
 
-	BOOST_FOREACH(SigBase *sig, m_pendingSignals)
+    } while( changed || m_woken );
+}
+
+void Simulation::wake( Context *ctx )
+{
+    assert( ctx->m_state == Context::SUSPENDED );
+
+    ctx->m_state = Context::IDLE;
+    m_woken++;
+}
+
+int64_t Simulation::next_event_time()
+{
+    int64_t next = m_injected.empty() ? c_noEvent : m_injected.top().m_time;
+
+    while(!m_eventTimers.empty())
+    {
+	const EventTimer& t = m_eventTimers.top();
+
+	// cancelled or replaced notifications are gone
+	if(t.m_gen == t.m_event->m_gen && t.m_event->m_pending == Event::TIMED)
 	{
+	    next = std::min( next, t.m_time );
+	    break;
+	}
 
-	    if(sig->m_drivers.empty() )
-	    {
-	        m_pendingSignals.erase(sig);
-		continue;
-	    }
+	m_eventTimers.pop();
+    }
 
-	    int n_drivers = 0;
+    while(!m_timers.empty())
+    {
+	const Timer& t = m_timers.top();
 
+	// timers of processes woken since they were armed are gone
+	if(t.m_gen == t.m_ctx->m_timerGen && t.m_ctx->m_state != Context::DONE)
+	    return std::min( next, t.m_time );
 
-	    BOOST_FOREACH(SigBase *drv, sig->m_drivers)
-	    {
-		n_drivers++;
-//		printf(" - drive \n");
-//		printf("- drive %s\n", drv->m_value);
-		sig->copy_value( drv ); // fixme: support multiple drivers
-		delete drv;
-	    }
+	m_timers.pop();
+    }
 
+    return next;
+}
+
+void Simulation::schedule_timer( Context *ctx, int64_t time )
+{
+    Timer t = { time, ctx->m_timerGen, ctx };
+    m_timers.push(t);
+}
+
+void Simulation::notify( Event& e )
+{
+    attach(e);
+    cancel(e);
+    trigger(e);
+}
 
-	    TRACE("%-8d: update signal %s [%d drivers] \n", m_time, sig->m_name.c_str(), n_drivers);
+void Simulation::notify( Event& e, int64_t delay )
+{
+    attach(e);
+
+    if(delay == 0)
+    {
+	if(e.m_pending == Event::DELTA)
+	    return;
 
-	    if(!sig->changed())
-	        m_pendingSignals.erase(sig);
-	    else
-		signals_changed = true;
-	    sig->m_drivers.clear();
+	cancel(e);
+	e.m_pending = Event::DELTA;
+	m_deltaEvents.push_back(&e);
+	return;
+    }
+
+    int64_t time = m_time + delay;
+
+    if(e.m_pending == Event::DELTA || (e.m_pending == Event::TIMED && e.m_time <= time))
+	return;
+
+    cancel(e);
+    e.m_pending = Event::TIMED;
+    e.m_time = time;
+
+    EventTimer t = { time, e.m_gen, &e };
+    m_eventTimers.push(t);
+}
+
+void Simulation::cancel( Event& e )
+{
+    // the queued entries are skipped when they surface
+    e.m_pending = Event::NONE;
+    e.m_gen++;
+}
+
+void Simulation::attach( Event& e )
+{
+    if(e.m_sim == this)
+	return;
+
+    assert( !e.m_sim && "an event belongs to one simulation" );
+    e.m_sim = this;
+    m_attachedEvents.push_back(&e);
+}
+
+void Simulation::detach( Event& e )
+{
+    m_attachedEvents.erase( std::remove( m_attachedEvents.begin(), m_attachedEvents.end(), &e ), m_attachedEvents.end() );
+    // stale entries too: they are only checked against e when they surface
+    m_deltaEvents.erase( std::remove( m_deltaEvents.begin(), m_deltaEvents.end(), &e ), m_deltaEvents.end() );
+
+    std::vector<EventTimer> keep;
+
+    while(!m_eventTimers.empty())
+    {
+	if(m_eventTimers.top().m_event != &e)
+	    keep.push_back( m_eventTimers.top() );
+	m_eventTimers.pop();
+    }
+
+    BOOST_FOREACH(const EventTimer& t, keep)
+	m_eventTimers.push(t);
+
+    e.m_sim = NULL;
+}
+
+void Simulation::release_events()
+{
+    BOOST_FOREACH(Event *e, m_attachedEvents)
+    {
+	e->m_pending = Event::NONE;
+	e->m_waiters.clear();
+	e->m_sim = NULL;
+    }
+
+    m_attachedEvents.clear();
+    m_deltaEvents.clear();
+    m_eventTimers = std::priority_queue<EventTimer, std::vector<EventTimer>, std::greater<EventTimer> >();
+}
+
+void Simulation::trigger( Event& e )
+{
+    BOOST_FOREACH(Context *ctx, e.m_waiters)
+	wake(ctx);
+    e.m_waiters.clear();
+}
+
+void Simulation::fire_delta_events()
+{
+    BOOST_FOREACH(Event *e, m_deltaEvents)
+    {
+	// cancelled, or replaced since
+	if(e->m_pending != Event::DELTA)
+	    continue;
+
+	e->m_pending = Event::NONE;
+	trigger(*e);
+    }
+
+    m_deltaEvents.clear();
+}
+
+void Simulation::fire_timed_events()
+{
+    while(!m_eventTimers.empty() && m_eventTimers.top().m_time <= m_time)
+    {
+	EventTimer t = m_eventTimers.top();
+	m_eventTimers.pop();
+
+	if(t.m_gen != t.m_event->m_gen || t.m_event->m_pending != Event::TIMED)
+	    continue;
+
+	t.m_event->m_pending = Event::NONE;
+	trigger(*t.m_event);
+    }
+}
+
+void Simulation::run_step()
+{
+    apply_injected();
+    fire_timed_events();
+    m_lastStep = m_time;
+
+    settle();
+    end_step();
+}
+
+void Simulation::step()
+{
+    run_step();
+
+//    printf("next T %lld\n", next_event_time());
+    m_time = next_event_time();
+    if(m_timeline)
+	trace_time();
+    SIM_PROBE( time_advance, m_time );
+}
+
+void Simulation::trace_time()
+{
+    m_tracing = m_timeline->covers(m_time);
+    if(m_tracing)
+	m_timeline->time(m_time);
+}
+
+void Simulation::inject( int64_t time, SigBase *sig, SigBase *value )
+{
+    InboxItem *item = new InboxItem;
+
+    item->m_time = time;
+    item->m_sig = sig;
+    item->m_value = value;
+    item->m_call = NULL;
+    item->m_arg = NULL;
+
+    item->m_next = m_inbox.load( std::memory_order_relaxed );
+    while( !m_inbox.compare_exchange_weak( item->m_next, item, std::memory_order_release, std::memory_order_relaxed ) )
+	;
+}
+
+void Simulation::inject_call( int64_t time, InjectedCall fn, void *arg )
+{
+    InboxItem *item = new InboxItem;
+
+    item->m_time = time;
+    item->m_sig = item->m_value = NULL;
+    item->m_call = fn;
+    item->m_arg = arg;
+
+    item->m_next = m_inbox.load( std::memory_order_relaxed );
+    while( !m_inbox.compare_exchange_weak( item->m_next, item, std::memory_order_release, std::memory_order_relaxed ) )
+	;
+}
+
+void Simulation::drain_inbox()
+{
+    InboxItem *item = m_inbox.exchange( NULL, std::memory_order_acquire ), *fifo = NULL;
+
+    // the inbox is newest first
+    while(item)
+    {
+	InboxItem *next = item->m_next;
+	item->m_next = fifo;
+	fifo = item;
+	item = next;
+    }
+
+    for(item = fifo; item; item = item->m_next)
+    {
+	// too late for its time: the next step that can still take it
+	Injection inj = { std::max( item->m_time, m_lastStep + 1 ), m_injectSeq++, item };
+
+	m_injected.push(inj);
+	m_time = std::min( m_time, inj.m_time );
+    }
+
+    if(fifo && m_timeline)
+	trace_time();
+}
+
+void Simulation::apply_injected()
+{
+    while(!m_injected.empty() && m_injected.top().m_time <= m_time)
+    {
+	InboxItem *item = m_injected.top().m_item;
+	m_injected.pop();
+
+	if(item->m_sig)
+	    drive( item->m_sig, item->m_value );
+	else
+	    item->m_call( this, item->m_arg );
+
+	delete item;
+    }
+}
+
+// spins briefly, then sleeps for increasing periods up to 100 us
+static void backoff( int& rounds )
+{
+    if(++rounds < 100)
+	return;
+
+    if(rounds < 200)
+    {
+	sched_yield();
+	return;
+    }
+
+    struct timespec ts = { 0, std::min( (rounds - 200) * 1000, 100000 ) };
+    nanosleep( &ts, NULL );
+}
+
+void Simulation::poll_inbox( int64_t units )
+{
+    int rounds = 0;
+
+    for(;;)
+    {
+	// the grant first: the partner injects before it grants, so every
+	// injection for a time below the grant is in the inbox by now
+	int64_t grant = m_lockstep ? m_grant.load( std::memory_order_acquire ) : c_noEvent;
+
+	if(m_inbox.load( std::memory_order_relaxed ))
+	    drain_inbox();
+
+	if(!m_lockstep)
+	    return;
+
+	// an injection may have moved m_time back below the grant
+	if(m_time < grant || grant >= c_noEvent)
+	    return;
+
+	// all steps before the grant are done: hand over to the partner
+	if(m_reached.load( std::memory_order_relaxed ) != grant)
+	{
+	    m_reached.store( grant, std::memory_order_release );
+	    rounds = 0;
 	}
-	
-	if(!signals_changed)
-	    break;
 
+	if(m_time >= units && grant >= units)
+	    return;
 
+	backoff(rounds);
+    }
+}
 
-    } while(1);
+void Simulation::advance_to( int64_t time )
+{
+    int rounds = 0;
 
-    
-    int64_t min_wait = 1000000000;
+    grant( time );
 
-    BOOST_FOREACH(Context *ctx, m_ctxs)
+    while( reached() < time )
+	backoff(rounds);
+}
+
+void Simulation::end_step()
+{
+    for(int i = 0; i < m_stepCallbacks.size(); i++)
+	m_stepCallbacks[i].first( m_time, m_stepChanges, m_stepCallbacks[i].second );
+
+    m_stepChanges.clear();
+    m_steps++;
+
+    if(m_telemetry)
+	m_telemetry->end_step();
+}
+
+void Simulation::add_value_callback( SigBase *sig, ValueChangeCallback cb, void *arg )
+{
+    if(!sig->m_callbacks)
+    {
+	sig->m_callbacks = new std::vector< std::pair<ValueChangeCallback, void *> >;
+	m_callbackSignals++;
+    }
+
+    sig->m_callbacks->push_back( std::make_pair(cb, arg) );
+}
+
+void Simulation::remove_value_callback( SigBase *sig, ValueChangeCallback cb, void *arg )
+{
+    if(!sig->m_callbacks)
+	return;
+
+    std::vector< std::pair<ValueChangeCallback, void *> >& cbs = *sig->m_callbacks;
+
+    for(int i = 0; i < cbs.size(); i++)
     {
-	if(ctx->m_state == Context::WAITING_TIME)
+	if(cbs[i].first == cb && cbs[i].second == arg)
 	{
-	    if( ctx->m_wait_until < min_wait )
-		min_wait = ctx->m_wait_until;
+	    // notify_change() is walking the list, it compacts it afterwards
+	    if(sig == m_dispatching)
+	    {
+		cbs[i].first = NULL;
+		m_callbacksRemoved = true;
+		return;
+	    }
+
+	    cbs.erase(cbs.begin() + i);
+	    break;
 	}
     }
 
-//    printf("next T %lld\n", min_wait);
-    m_time = min_wait;
+    // back to the free path
+    if(cbs.empty())
+    {
+	delete sig->m_callbacks;
+	sig->m_callbacks = NULL;
+	m_callbackSignals--;
+    }
+}
+
+void Simulation::compact_callbacks( SigBase *sig )
+{
+    std::vector< std::pair<ValueChangeCallback, void *> >& cbs = *sig->m_callbacks;
+    int n = 0;
+
+    for(int i = 0; i < cbs.size(); i++)
+	if(cbs[i].first)
+	    cbs[n++] = cbs[i];
+
+    cbs.resize(n);
+    m_callbacksRemoved = false;
+
+    if(cbs.empty())
+    {
+	delete sig->m_callbacks;
+	sig->m_callbacks = NULL;
+	m_callbackSignals--;
+    }
+}
+
+void Simulation::add_step_callback( StepCallback cb, void *arg )
+{
+    m_stepCallbacks.push_back( std::make_pair(cb, arg) );
+    m_recordChanges = true;
+}
+
+void Simulation::settle_comb()
+{
+    // no sensitivity checks: rerun all combinational logic until it stops
+    // producing new values
+    do {
+	m_delta++;
+	m_deltas++;
+
+	BOOST_FOREACH(CycleProcess *p, m_comb)
+	    p->m_body(p->m_ctx);
+
+    } while( commit() );
 }
 
+void Simulation::run_cycles(int64_t units)
+{
+    BOOST_FOREACH(Context *ctx, m_ctxs)
+	assert( ctx->m_cycle && "only clock, clocked and combinational processes run in cycle-based mode" );
+    assert( m_clocks.size() == 1 );
+
+    CycleProcess *clock = m_clocks[0];
+    Logic *clk = clock->m_clock;
+
+    m_delta = 0;
+
+    if(m_time == 0)
+	settle_comb();
+    clear_committed();
+
+    dump();
+
+    while(m_time < units && !m_stopped)
+    {
+	bool rising = !clk->value();
+
+	clk->m_old_value = clk->m_value;
+	clk->m_value = rising ? 1 : 0;
+	m_delta = 0;
+	m_events++;
+
+	if(clk->m_callbacks || m_recordChanges)
+	    notify_change(clk, clk->m_old_value);
+
+	if(rising)
+	{
+	    BOOST_FOREACH(CycleProcess *p, m_clocked)
+		p->m_body(p->m_ctx);
+
+	    commit();
+	    settle_comb();
+	}
+
+	// change flags mean nothing here: no process waits on them, and
+	// m_committed would grow for the whole run
+	clear_committed();
+	clk->clear_changed();
+
+	end_step();
+	m_time += clock->m_halfPeriod;
+	if(m_timeline)
+	    trace_time();
+	SIM_PROBE( time_advance, m_time );
+
+	dump();
+    }
+}
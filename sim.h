@@ -9,6 +9,8 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <atomic>
+#include <queue>
 
 #include <boost/foreach.hpp>
 
@@ -17,6 +19,31 @@
 using namespace std;
 
 class VCDWriter;
+class Telemetry;
+class WaveCompare;
+class Timeline;
+class SigBase;
+class Simulation;
+
+/**
+ * Struct ValueChange
+ * A committed signal change, as seen by value change callbacks. m_old and
+ * m_new are the raw bits of the signal (see SigBase::raw_value()).
+ */
+struct ValueChange
+{
+    SigBase *m_sig;
+    int64_t m_time;
+    uint64_t m_old;
+    uint64_t m_new;
+};
+
+// called from the commit phase for every change of a signal
+typedef void (*ValueChangeCallback)( const ValueChange& change, void *arg );
+// called once per time step with all changes of that step, in commit order
+typedef void (*StepCallback)( int64_t time, const std::vector<ValueChange>& changes, void *arg );
+// posted with Simulation::inject_call(), runs in the kernel thread
+typedef void (*InjectedCall)( Simulation *sim, void *arg );
 
 
 #ifdef DEBUG
@@ -25,14 +52,56 @@ class VCDWriter;
 #define TRACE(...)
 #endif
 
+/**
+ * Class SigBase
+ * Common part of all signals, kept small: the vtable, the ID, the flags and
+ * the callback pointer. Names live in a table keyed by the ID (unnamed
+ * signals, such as temporaries, have no entry and cost no allocation), and
+ * the values posted in a delta live in the kernel (Simulation::m_updates).
+ */
 class SigBase 
 {
 public:
-    SigBase ( const  std::string name = "?") : m_name(name) {
+    enum Flags {
+	// queued in Simulation::m_pendingSignals
+	POSTED = 1,
+	// has an entry in the name table
+	NAMED = 2
+    };
+
+    SigBase ( const  std::string name = "?") : m_flags(0), m_callbacks(NULL) {
+	m_id = m_staticSigId++;
+
+	if(name != "?")
+	    set_name(name);
+    }
+
+    // a copy is a new, unnamed signal without callbacks: the ID, the name
+    // table entry and the callback list belong to the original
+    SigBase ( const SigBase& other ) : m_flags(0), m_callbacks(NULL) {
 	m_id = m_staticSigId++;
     }
+
+    // assigning copies values (in the derived classes), never the identity
+    SigBase& operator=( const SigBase& other )
+    {
+	return *this;
+    }
+
+    virtual ~SigBase()
+    {
+	delete m_callbacks;
+
+	if(m_flags & NAMED)
+	    set_name("?");
+    }
  
-    static int m_staticSigId;
+    // atomic: partitions create temporaries from several threads
+    static std::atomic<int> m_staticSigId;
+
+    // "?" for unnamed signals
+    const std::string& name() const;
+    void set_name( const std::string& name );
 
     virtual SigBase *clone() const = 0;
     virtual void copy_value ( const SigBase *b) =0;
@@ -40,210 +109,238 @@ public:
     virtual bool changed() const =0;
     virtual void clear_changed() = 0;
 
-    std::vector<SigBase *> m_drivers;
+    /**
+     * Function update()
+     * Commit phase, after the kernel has applied the values driven in the
+     * last delta: signals posting their own updates (Simulation::post())
+     * apply them here. Returns false if nothing was posted.
+     */
+    virtual bool update()
+    {
+	return true;
+    }
+
+    // current bits for observers (value change callbacks), 0 if not representable
+    virtual uint64_t raw_value() const
+    {
+	return 0;
+    }
 
-    std::string m_name;
     int m_id;
-//    SigBase *m_old_value;
+    uint32_t m_flags;
+
+    // value change callbacks, NULL unless some were added (see Simulation::add_value_callback())
+    std::vector< std::pair<ValueChangeCallback, void *> > *m_callbacks;
 };
 
-class Logic : public SigBase
+/**
+ * Struct LogicValue
+ * Plain bit vector value (width + bits). Results of all operators on Logic
+ * signals are LogicValues: they are not signals, carry no name or ID and
+ * compile down to straight integer arithmetic.
+ */
+struct LogicValue
 {
-public:
+    LogicValue( int bits = 1, uint64_t value = 0 ) :
+	m_bits( bits ), m_value( value & width_mask(bits) ) {}
 
-    virtual Logic *clone() const
+    static uint64_t width_mask( int bits )
     {
-	Logic *l = new Logic;
-	l->m_bits= m_bits;
-	l->m_value = m_value;
-	l->m_old_value = m_value;
-	return l;
+	return bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
     }
 
-    virtual void copy_value ( const SigBase *b) 
+    uint64_t mask() const
     {
-	m_old_value = m_value;
-	m_value = static_cast<const Logic *> (b)->m_value;
+	return width_mask(m_bits);
     }
 
-    virtual bool changed() const
+    uint64_t value() const
     {
-	bool ch = (m_value ^ m_old_value) & ((1ULL<<m_bits) - 1);
-//	TRACE("old_value %d new_value %d ch %d\n", m_value, m_old_value, !!ch);
-
-	return ch;
+	return m_value;
     }
 
-    void clear_changed() 
+    LogicValue range(int rmax, int rmin ) const
     {
-	m_old_value = m_value;
-    }
+	assert (rmax >= rmin);
 
-    Logic(int bits=1, string name="?"): SigBase(name), m_bits(bits), m_old_value(0), m_value(0) {}
+	return LogicValue( rmax - rmin + 1, m_value >> rmin );
+    }
 
-    Logic set_value( int value )
+    LogicValue range(int bit) const
     {
-	m_old_value = m_value;
-	m_value = value;
-	return *this;
+	return range(bit, bit);
     }
 
-    uint64_t value() const
+    LogicValue range(const LogicValue& bit) const
     {
-	return m_value;
+	return range(bit.m_value);
     }
 
-    
-    void initial(Logic value)
+
+    LogicValue operator>>(int  b) const
     {
-	m_value = value.m_value;
+	return LogicValue( m_bits, m_value >> b );
     }
 
-    Logic range(int rmax, int rmin )
+    LogicValue operator<<(int  b) const
     {
-	assert (rmax >= rmin);
-
-	uint64_t tmp = m_value >> rmin;
-
-	tmp &= (1ULL << (rmax-rmin+1)) - 1 ;
-
-	Logic rv(rmax-rmin+1);
-	rv.m_value = tmp;
-	return rv;
+	return LogicValue( m_bits, m_value << b );
     }
 
-    Logic range(int bit)
+    LogicValue operator-(const LogicValue& b) const
     {
-	return range(bit, bit);
+	return LogicValue( m_bits, m_value - b.m_value );
     }
 
-    Logic range(const Logic& bit)
+    LogicValue operator+(const LogicValue& b) const
     {
-	return range(bit.m_value);
+	return LogicValue( m_bits, m_value + b.m_value );
     }
-    
 
+    LogicValue operator^(const LogicValue& b) const
+    {
+	return LogicValue( m_bits, m_value ^ b.m_value );
+    }
 
-    Logic operator>>(int  b)
+    LogicValue operator|(const LogicValue& b) const
     {
-	Logic rv(m_bits);
-	rv.m_value = (m_value >> b);
-	return rv;
+	return LogicValue( m_bits, m_value | b.m_value );
     }
 
-    Logic operator<<(int  b)
+    LogicValue operator&(const LogicValue& b) const
     {
-	Logic rv(m_bits);
-	rv.m_value = (m_value << b);
-	return rv;
+	return LogicValue( m_bits, m_value & b.m_value );
     }
 
 
-    uint64_t mask(int n_bits)
+    LogicValue operator||(const LogicValue& b) const
     {
-	if(n_bits==64)
-	    return 0xffffffffffffffffULL;
-	else
-	    return ((1ULL<<m_bits) - 1);
+	return LogicValue( 1, (m_value || b.m_value) ? 1 : 0 );
+    }
+
+    LogicValue operator&&(const LogicValue& b) const
+    {
+	return LogicValue( 1, (m_value && b.m_value) ? 1 : 0 );
     }
 
-    Logic operator-(const Logic& b)
+    bool operator==(const LogicValue& b) const
     {
-	Logic rv(m_bits);
-	rv.m_value = (m_value - b.m_value) & mask(std::max(m_bits, b.m_bits));
-	return rv;
+	return (m_value == b.m_value);
     }
 
-    Logic operator^(const Logic& b)
+    bool operator!=(const LogicValue& b) const
     {
-	Logic rv(m_bits);
-	rv.m_value = (m_value ^ b.m_value) & mask(m_bits);
-	return rv;
+	return (m_value != b.m_value);
     }
 
 
-    Logic operator|(const Logic& b)
+    LogicValue operator~() const
     {
-	Logic rv(m_bits);
-	rv.m_value = (m_value | b.m_value) & mask(m_bits);
-	return rv;
+	return LogicValue( m_bits, ~m_value );
     }
 
-    Logic operator&(const Logic& b)
+    LogicValue operator!() const
     {
-	Logic rv(m_bits);
-	rv.m_value = (m_value & b.m_value) & mask(m_bits);
-	return rv;
+	return LogicValue( m_bits, ( m_value == 0 ) ? 1 : 0 );
     }
 
+    int m_bits;
+    uint64_t m_value;
+};
 
-    Logic operator||(const Logic& b)
-    {
-	Logic rv(1);
+static inline LogicValue concat ( const LogicValue&a, const LogicValue& b )
+{
+    return LogicValue( a.m_bits + b.m_bits, (a.m_value << b.m_bits) | b.m_value );
+}
 
-	bool op1 = (m_value) & mask(m_bits) ;
-	bool op2 = (b.m_value) & mask(b.m_bits);
 
-	rv.m_value = (op1 || op2) ? 1 : 0;
-	return rv;
+class Logic : public SigBase, public LogicValue
+{
+public:
+    typedef LogicValue ValueType;
+
+    virtual Logic *clone() const
+    {
+	Logic *l = new Logic(m_bits);
+	l->m_value = m_value;
+	l->m_old_value = m_value;
+	return l;
     }
 
-    Logic operator&&(const Logic& b)
+    Logic *make_driver( const LogicValue& value ) const
     {
-	Logic rv(1);
+	Logic *l = new Logic(m_bits);
+	l->m_value = value.m_value & mask();
+	l->m_old_value = l->m_value;
+	return l;
+    }
 
-	bool op1 = (m_value) & mask(m_bits) ;
-	bool op2 = (b.m_value) & mask(b.m_bits);
+    bool equals( const LogicValue& value ) const
+    {
+	return m_value == (value.m_value & mask());
+    }
 
-	rv.m_value = (op1 && op2) ? 1 : 0;
-	return rv;
+    virtual void copy_value ( const SigBase *b) 
+    {
+	m_old_value = m_value;
+	m_value = static_cast<const Logic *> (b)->m_value;
     }
 
-    Logic operator+(const Logic& b)
+    // commit of a value driven with Simulation::drive( Logic *, uint64_t )
+    void apply( uint64_t value )
     {
-	Logic rv(m_bits);
-	rv.m_value = (m_value + b.m_value) & mask(std::max(m_bits, b.m_bits));
-	return rv;
+	m_old_value = m_value;
+	m_value = value;
     }
 
-    static Logic from_int( int value )
+    virtual bool changed() const
     {
-	Logic rv(32);
-	rv.m_value = value;
-	return rv;
+	bool ch = (m_value ^ m_old_value) & mask();
+//	TRACE("old_value %d new_value %d ch %d\n", m_value, m_old_value, !!ch);
+
+	return ch;
     }
 
-    static Logic from_string( const std::string value )
+    void clear_changed() 
     {
-	Logic rv(32);
-	rv.m_value = 0;
-	return rv;
+	m_old_value = m_value;
     }
 
-    bool operator==(const Logic& b) const
+    virtual uint64_t raw_value() const
     {
-	return (m_value == b.m_value);
+	return m_value;
     }
 
-    bool operator!=(const Logic& b) const
+    Logic(int bits=1, string name="?"): SigBase(name), LogicValue(bits), m_old_value(0) {}
+
+    // local variables of processes take both the width and value of an expression
+    Logic& operator=( const LogicValue& value )
     {
-	return (m_value != b.m_value);
+	m_bits = value.m_bits;
+	m_value = value.m_value;
+	return *this;
+    }
 
+    LogicValue set_value( int value )
+    {
+	m_old_value = m_value;
+	m_value = value & mask();
+	return *this;
     }
 
+    void initial(const LogicValue& value)
+    {
+	m_value = value.m_value & mask();
+    }
 
-    Logic operator~() const
+    static LogicValue from_int( int value )
     {
-	Logic rv(m_bits);
-	rv.m_value = (~m_value ) & ((1ULL<<m_bits) - 1);
-	return rv;	
+	return LogicValue( 32, value );
     }
 
-    Logic operator!() const
+    static LogicValue from_string( const std::string value )
     {
-	Logic rv(m_bits);
-	rv.m_value = ( m_value == 0 ) ? 1 : 0;
-	return rv;	
+	return LogicValue( 32, 0 );
     }
 
     bool pos_edge() const
@@ -253,35 +350,82 @@ public:
     }
 
 //private:
-    int m_bits;
-    uint64_t m_value;
     uint64_t m_old_value;
 
 };
 
-static Logic concat ( const Logic&a, const Logic& b )
+class Context;
+class Event;
+template<class T> class Signal;
+
+/**
+ * Struct Process
+ * Handle of one run of a spawned process. Contexts are recycled once their
+ * process returns, so a handle stays valid (and done()) after that.
+ */
+struct Process
 {
-    Logic rv (a.m_bits + b.m_bits);
-
-    rv.m_value = a.m_value << b.m_bits;
-    rv.m_value |= b.m_value;
-
-//    printf("Concat %d %d %lx %lx -> %d %lx\n", a.m_bits, b.m_bits, a.m_value, b.m_value, rv.m_bits, rv.m_value);
-
-    return rv;
-}
+    Context *m_ctx;
+    uint64_t m_run;
 
-class Context;
+    bool done() const;
+};
 
 
 class Simulation
 {
 public:
 
+    ///> returned by next_event_time() when nothing is scheduled
+    static const int64_t c_noEvent = 1000000000;
+
+    enum EngineMode {
+	EVENT_DRIVEN = 0,
+	CYCLE_BASED = 1
+    };
+
+    /**
+     * Struct CycleProcess
+     * A clock, clocked or combinational process registered for cycle-based
+     * simulation. The same registration also runs in event-driven mode,
+     * through a coroutine stub in m_ctx.
+     */
+    struct CycleProcess
+    {
+	int (*m_body)(Context *);
+	Logic *m_clock;
+	int64_t m_halfPeriod;
+	std::set<SigBase *> m_sensitivity;
+	Context *m_ctx;
+    };
+
     Simulation()
     {
 	m_time = 0;
 	m_writer = NULL;
+	m_telemetry = NULL;
+	m_compare = NULL;
+	m_timeline = NULL;
+	m_tracing = false;
+	m_stopped = false;
+	m_inbox.store( NULL );
+	m_injectSeq = 0;
+	m_lastStep = -1;
+	m_lockstep = false;
+	m_grant.store( c_noEvent );
+	m_reached.store( 0 );
+	m_recordChanges = false;
+	m_dispatching = NULL;
+	m_callbacksRemoved = false;
+	m_callbackSignals = 0;
+	m_woken = 0;
+	m_events = m_deltas = m_steps = 0;
+    }
+
+    // the Events used here outlive it, e.g. as globals: they forget it
+    ~Simulation()
+    {
+	release_events();
     }
 
     bool do_contexts(bool signals_changed);
@@ -291,10 +435,202 @@ public:
 	m_signals.insert(sig);
     }
 
-    void add_process( int (*proc)(Context *), const std::string name, bool continuous  );
+    // arg is handed to the process as Context::m_arg. Processes without
+    // floating point code may skip saving the FP state on every switch:
+    // add_process(...)->m_cofunc.SetPreserveFPU(false)
+    Context *add_process( int (*proc)(Context *), const std::string name, bool continuous, void *arg = NULL );
+
+    /**
+     * Function spawn()
+     * Starts proc as a new process, from a running process or before run().
+     * It starts in the next delta cycle and retires when proc returns: its
+     * Context, with the coroutine stack and the slot in m_ctxs, goes back
+     * to a pool for the next spawn(), so short-lived processes cost neither
+     * allocations nor scheduler slots once the pool is warm.
+     */
+    Process spawn( int (*proc)(Context *), const std::string name, void *arg = NULL );
+
+    // called when a spawned process returns: wakes its joiners, pools its Context
+    void retire( Context *ctx );
+
+    // clock toggled by the kernel every half_period, rising first at time 0
+    void add_clock( Logic *clk, int64_t half_period );
+
+    /**
+     * Function add_clocked_process()
+     * proc runs once per rising edge of clk. It reads the values from before
+     * the edge, assigns its outputs and returns - it must not wait.
+     */
+    void add_clocked_process( int (*proc)(Context *), Logic *clk, const std::string name, void *arg = NULL );
+
+    /**
+     * Function add_comb_process()
+     * proc recomputes its outputs from its inputs and returns - it must not
+     * wait. It runs once at startup and then, in event-driven mode, whenever
+     * a signal of sensitivity changes; in cycle-based mode, until the
+     * combinational logic settles after each clock edge.
+     */
+    void add_comb_process( int (*proc)(Context *), const std::set<SigBase *>& sensitivity,
+			   const std::string name, void *arg = NULL );
+
+    /**
+     * Posts a new value for sig, to be committed in the current delta
+     * (takes ownership of value). Used by Context::assign() and by
+     * engines feeding signals from outside of a process.
+     */
+    void drive( SigBase *sig, SigBase *value )
+    {
+	Update u = { sig, value, 0 };
+
+	m_updates.push_back( u );
+	post( sig );
+    }
+
+    // posts the raw bits of a new value for a Logic signal, no driver object
+    void drive( Logic *sig, uint64_t value )
+    {
+	Update u = { sig, NULL, value };
+
+	m_updates.push_back( u );
+	post( sig );
+    }
+
+    // schedules sig->update() for the commit of the current delta
+    void post( SigBase *sig )
+    {
+	if(!(sig->m_flags & SigBase::POSTED))
+	{
+	    sig->m_flags |= SigBase::POSTED;
+	    m_pendingSignals.push_back( sig );
+	}
+    }
 
+    /**
+     * Makes a process suspended with Context::suspend() runnable again in
+     * the current delta, without a signal in between (used by channels).
+     */
+    void wake( Context *ctx );
+
+    // runs delta cycles at the current time until no signal changes and no
+    // process was woken
+    void settle();
+    // time of the earliest pending timed wait or timeout (c_noEvent if none)
+    int64_t next_event_time();
+
+    /**
+     * Function schedule_timer()
+     * Arms ctx's timer for time. A timer is cancelled in O(1) by bumping
+     * ctx->m_timerGen; the stale heap entry is dropped when it surfaces.
+     */
+    void schedule_timer( Context *ctx, int64_t time );
+
+    /**
+     * Function notify()
+     * Immediate notification: the processes waiting on e become runnable in
+     * the current delta, like wake(). Cancels a pending notification of e.
+     */
+    void notify( Event& e );
+
+    /**
+     * Function notify()
+     * Delayed notification: the waiters of e at that point run in the next
+     * delta (delay 0) or at the time step delay units from now. An event
+     * holds one pending notification; the earlier one wins.
+     */
+    void notify( Event& e, int64_t delay );
+    void cancel( Event& e );
+
+    /**
+     * Function attach()
+     * Binds e to this simulation on its first wait or notification, so that
+     * ~Event can take its queued notifications back (detach()).
+     */
+    void attach( Event& e );
+    void detach( Event& e );
+    // drops the pending notifications and waiters of all attached events
+    void release_events();
+
+    // applies the pending assignments, returns true if any signal changed
+    bool commit();
+    // resets the change flags of the committed signals
+    void clear_committed();
+
+    /**
+     * Function run_step()
+     * Simulates the time step at m_time: due injections and timed event
+     * notifications, the delta cycles, then the per-step hooks. Engines
+     * that pick the time themselves (Partition::run()) call it instead of
+     * step().
+     */
+    void run_step();
+    // run_step(), then advances m_time to the next event
     void step();
-    void run(int64_t units);
+
+    /**
+     * Function run()
+     * Simulates until time units. CYCLE_BASED runs only kernel clocks,
+     * clocked and combinational processes: no timed waits, no sensitivity
+     * checks, just edge -> clocked processes -> commit -> settle per cycle.
+     */
+    void run(int64_t units, EngineMode mode = EVENT_DRIVEN);
+
+    void run_cycles(int64_t units);
+    void settle_comb();
+
+    /**
+     * Function add_value_callback()
+     * Calls cb( change, arg ) from the commit phase whenever sig changes,
+     * without a process in between (like VPI cbValueChange). Signals without
+     * callbacks pay nothing but a NULL pointer test.
+     */
+    void add_value_callback( SigBase *sig, ValueChangeCallback cb, void *arg = NULL );
+    void remove_value_callback( SigBase *sig, ValueChangeCallback cb, void *arg = NULL );
+    // drops the entries removed while sig's callbacks were dispatched
+    void compact_callbacks( SigBase *sig );
+
+    /**
+     * Function add_step_callback()
+     * Calls cb( time, changes, arg ) at the end of every time step (every
+     * half clock period in cycle-based mode), after the design has settled,
+     * with the list of all signal changes of that step. Changes are only
+     * recorded while step callbacks are registered.
+     */
+    void add_step_callback( StepCallback cb, void *arg = NULL );
+
+    // reports a committed change to the callbacks
+    void notify_change( SigBase *sig, uint64_t old_value )
+    {
+	ValueChange vc = { sig, m_time, old_value, sig->raw_value() };
+
+	if(sig->m_callbacks)
+	{
+	    // a callback may remove itself or others: removals only clear the
+	    // entry while dispatching (see remove_value_callback()), callbacks
+	    // added meanwhile get the next change
+	    int n = sig->m_callbacks->size();
+
+	    m_dispatching = sig;
+	    for(int i = 0; i < n; i++)
+	    {
+		std::pair<ValueChangeCallback, void *> cb = (*sig->m_callbacks)[i];
+
+		if(cb.first)
+		    cb.first( vc, cb.second );
+	    }
+	    m_dispatching = NULL;
+
+	    if(m_callbacksRemoved)
+		compact_callbacks(sig);
+	}
+
+	if(m_recordChanges)
+	    m_stepChanges.push_back(vc);
+    }
+
+    // hands the changes of the finished time step to the step callbacks
+    void end_step();
+    // the time advanced: opens or closes the timeline window
+    void trace_time();
 
     int64_t get_time()
     {
@@ -306,15 +642,246 @@ public:
 	m_writer = writer;
     }
 
+    /**
+     * Function inject()
+     * Thread-safe: posts a new value for sig (taking ownership of value) at
+     * time, from any thread. Updates go through a lock-free inbox that the
+     * kernel drains before each time step; an update for a time already
+     * simulated is applied in the next step. In lockstep mode, inject at or
+     * after reached() for deterministic results.
+     */
+    void inject( int64_t time, SigBase *sig, SigBase *value );
+
+    void inject( int64_t time, Logic& sig, const LogicValue& value )
+    {
+	inject( time, &sig, sig.make_driver(value) );
+    }
+
+    // thread-safe: calls fn( sim, arg ) from the kernel thread at time
+    void inject_call( int64_t time, InjectedCall fn, void *arg = NULL );
+
+    /**
+     * Lockstep co-simulation: after enable_lockstep(), run() only simulates
+     * times below the grant of the partner thread. advance_to(t) grants t
+     * and returns once every time step before t is done; the simulation
+     * is then blocked and its signals can be read safely until the next
+     * grant. release_lockstep() lets the simulation run freely to the end.
+     * No mutex: both sides wait on atomics.
+     */
+    void enable_lockstep()
+    {
+	m_lockstep = true;
+	m_grant.store( 0 );
+	m_reached.store( 0 );
+    }
+
+    void grant( int64_t time )
+    {
+	m_grant.store( time, std::memory_order_release );
+    }
+
+    // every time step before reached() has been simulated
+    int64_t reached() const
+    {
+	return m_reached.load( std::memory_order_acquire );
+    }
+
+    void advance_to( int64_t time );
+
+    void release_lockstep()
+    {
+	grant( c_noEvent );
+    }
+
+    // makes run() return at the end of the current time step
+    void stop()
+    {
+	m_stopped = true;
+    }
+
+    // dump point: the VCD writer and the golden comparator see the signals
+    void dump();
+
 
     VCDWriter *m_writer;
+    // set by a live Telemetry, published from end_step()
+    Telemetry *m_telemetry;
+    // set by a live WaveCompare, checked at every dump point
+    WaveCompare *m_compare;
+    // set by Timeline::attach(); m_tracing while the time is in its window
+    Timeline *m_timeline;
+    bool m_tracing;
+    bool m_stopped;
 
     std::set<SigBase *> m_signals;
-    std::set<SigBase *> m_pendingSignals;
+    // posted signals, once each, in posting order
+    std::vector<SigBase *> m_pendingSignals;
+
+    // a value driven in the current delta: a driver object (owned) or,
+    // for Logic, the raw bits
+    struct Update
+    {
+	SigBase *m_sig;
+	SigBase *m_driver;
+	uint64_t m_value;
+    };
+
+    // values driven in the current delta, applied in order by commit()
+    std::vector<Update> m_updates;
+    // raw values of the pending signals before the commit, for observers
+    std::vector<uint64_t> m_oldValues;
+    // signals with value callbacks; commit() takes no snapshot while 0
+    int m_callbackSignals;
+    // signals changed by the last commit, their change flags are cleared
+    // once the processes have seen them
+    std::vector<SigBase *> m_committed;
     std::vector<Context *> m_ctxs;
+    // retired spawned processes, ready for reuse (they keep their m_ctxs slot)
+    std::vector<Context *> m_pool;
+    // spawned in this delta, started when the process loop is done
+    std::vector<Context *> m_spawned;
+
+    std::vector<CycleProcess *> m_clocks, m_clocked, m_comb;
+
+    std::vector< std::pair<StepCallback, void *> > m_stepCallbacks;
+    std::vector<ValueChange> m_stepChanges;
+    bool m_recordChanges;
+    // the signal whose value callbacks run, removals from it are deferred
+    SigBase *m_dispatching;
+    bool m_callbacksRemoved;
 
     int64_t m_time;
     int m_delta;
+    // processes woken during the current delta
+    int m_woken;
+
+    // run statistics: committed signal changes, delta cycles, time steps
+    uint64_t m_events, m_deltas, m_steps;
+
+    struct Timer
+    {
+	int64_t m_time;
+	uint64_t m_gen;
+	Context *m_ctx;
+
+	bool operator>( const Timer& b ) const
+	{
+	    return m_time > b.m_time;
+	}
+    };
+
+    // pending timed waits and timeouts, earliest first
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer> > m_timers;
+
+    // a timed Event notification, stale once the event's m_gen moved on
+    struct EventTimer
+    {
+	int64_t m_time;
+	uint64_t m_gen;
+	Event *m_event;
+
+	bool operator>( const EventTimer& b ) const
+	{
+	    return m_time > b.m_time;
+	}
+    };
+
+    // wakes the waiters of e
+    void trigger( Event& e );
+    // fires the delta notifications posted in the last delta
+    void fire_delta_events();
+    // fires the timed notifications due at m_time
+    void fire_timed_events();
+
+    std::vector<Event *> m_deltaEvents;
+    std::priority_queue<EventTimer, std::vector<EventTimer>, std::greater<EventTimer> > m_eventTimers;
+    // the events bound by attach()
+    std::vector<Event *> m_attachedEvents;
+
+    // an update or call posted by another thread
+    struct InboxItem
+    {
+	InboxItem *m_next;
+	int64_t m_time;
+	SigBase *m_sig, *m_value;
+	InjectedCall m_call;
+	void *m_arg;
+    };
+
+    struct Injection
+    {
+	int64_t m_time;
+	uint64_t m_seq;
+	InboxItem *m_item;
+
+	bool operator>( const Injection& b ) const
+	{
+	    return m_time > b.m_time || (m_time == b.m_time && m_seq > b.m_seq);
+	}
+    };
+
+    // moves the inbox into m_injected; in lockstep mode, waits for a grant
+    // above m_time (or units)
+    void poll_inbox( int64_t units );
+    void drain_inbox();
+    // applies the injections due at m_time
+    void apply_injected();
+
+    // lock-free LIFO of InboxItems, pushed by any thread, emptied by the kernel
+    std::atomic<InboxItem *> m_inbox;
+    // drained injections by time, then arrival
+    std::priority_queue<Injection, std::vector<Injection>, std::greater<Injection> > m_injected;
+    uint64_t m_injectSeq;
+    // time of the last simulated step
+    int64_t m_lastStep;
+
+    bool m_lockstep;
+    std::atomic<int64_t> m_grant, m_reached;
+};
+
+
+/**
+ * Class Event
+ * A pure synchronization point between processes, like sc_event: no value,
+ * no VCD entry, no commit. Context::wait(e) suspends the process; a
+ * notification wakes it directly (Simulation::wake()), immediately, in the
+ * next delta or at a later time step. A notification with nobody waiting
+ * is lost. An Event may be destroyed while notified (the notification is
+ * cancelled), but not while processes wait on it: they would never wake.
+ */
+class Event
+{
+public:
+    enum Pending {
+	NONE = 0,
+	DELTA = 1,
+	TIMED = 2
+    };
+
+    Event( const std::string name = "?" ) : m_name( name ), m_pending( NONE ), m_time( 0 ), m_gen( 0 ), m_sim( NULL ) {}
+
+    ~Event()
+    {
+	assert( m_waiters.empty() && "processes still wait on a destroyed event" );
+
+	if(m_sim)
+	    m_sim->detach(*this);
+    }
+
+    bool pending() const
+    {
+	return m_pending != NONE;
+    }
+
+    std::string m_name;
+    Pending m_pending;
+    // time of a TIMED notification
+    int64_t m_time;
+    // bumped when a pending notification is cancelled or replaced
+    uint64_t m_gen;
+    std::vector<Context *> m_waiters;
+    // set by Simulation::attach(), NULL once that simulation is gone
+    Simulation *m_sim;
 };
 
 
@@ -327,12 +894,31 @@ public:
 	WAITING_TIME = 1,
 	WAITING_EVENT = 2,
 	DONE = 3,
-	CONTINUOUS = 4
+	CONTINUOUS = 4,
+	SUSPENDED = 5
+    };
+
+    // why a wait returned
+    enum WakeReason {
+	WAKE_SIGNAL = 0,
+	WAKE_EDGE = 1,
+	WAKE_TIMEOUT = 2
     };
 
+    // timeout argument: wait forever
+    static const int64_t c_noTimeout = -1;
+
     Context()
     {
 	m_state = IDLE;
+	m_arg = NULL;
+	m_cycle = NULL;
+	m_timerGen = 0;
+	m_hasTimeout = false;
+	m_trigger = NULL;
+	m_pooled = false;
+	m_slot = -1;
+	m_run = 0;
     }
 
     template<class T>
@@ -340,12 +926,41 @@ public:
     {
 	if (sig != value)
 	{
-	    TRACE("%-8lld: assign %s [%p] value 0x%lx\n", m_sim->m_time, sig.m_name.c_str(), &sig, value.m_value);
-	    sig.m_drivers.push_back ( value.clone() );
-	    m_sim->m_pendingSignals.insert(&sig);
+	    TRACE("%-8lld: assign %s [%p] value 0x%lx\n", m_sim->m_time, sig.name().c_str(), &sig, value.m_value);
+	    m_sim->drive( &sig, value.clone() );
 	}
     }
 
+    // Logic takes the raw bits, without a driver object
+    void assign(Logic& sig, const LogicValue& value)
+    {
+	if (!sig.equals(value))
+	    m_sim->drive( &sig, value.m_value & sig.mask() );
+    }
+
+    void assign(Logic& sig, const Logic& value)
+    {
+	assign( sig, (const LogicValue&) value );
+    }
+
+    /**
+     * Assigns a plain value to a signal type declaring its value type as
+     * T::ValueType. Such signals provide equals() and make_driver().
+     */
+    template<class T>
+	void assign(T& sig, const typename T::ValueType& value)
+    {
+	if (!sig.equals(value))
+	    m_sim->drive( &sig, sig.make_driver(value) );
+    }
+
+    // typed signals (typedsig.h) keep the next value inline, no driver object
+    template<class T>
+	void assign(Signal<T>& sig, const typename Signal<T>::Type& value)
+    {
+	sig.write( m_sim, value );
+    }
+
     bool eval()
     {
 //	printf("%-8d: eval %p\n", m_sim->m_time, this);
@@ -354,9 +969,74 @@ public:
 	else
     	    m_cofunc.Call(this);
 
+	if(!m_cofunc.Running() && m_pooled)
+	{
+	    m_sim->retire(this);
+	    return false;
+	}
+
 	return m_cofunc.Running();
     }
 
+    Process spawn( int (*proc)(Context *), const std::string name, void *arg = NULL )
+    {
+	return m_sim->spawn( proc, name, arg );
+    }
+
+    // waits until the spawned process p has returned
+    void join( const Process& p )
+    {
+	while(!p.done())
+	{
+	    p.m_ctx->m_joiners.push_back(this);
+	    suspend();
+	}
+    }
+
+    void join_all( const std::vector<Process>& procs )
+    {
+	BOOST_FOREACH(const Process& p, procs)
+	    join(p);
+    }
+
+    /**
+     * Function join_any()
+     * Waits until one of procs has returned, returns its index.
+     */
+    int join_any( const std::vector<Process>& procs )
+    {
+	for(;;)
+	{
+	    for(int i = 0; i < procs.size(); i++)
+	    {
+		if(procs[i].done())
+		{
+		    // no wakeups from the others
+		    BOOST_FOREACH(const Process& p, procs)
+			if(!p.done())
+			    p.m_ctx->unjoin(this);
+		    return i;
+		}
+	    }
+
+	    BOOST_FOREACH(const Process& p, procs)
+		p.m_ctx->m_joiners.push_back(this);
+	    suspend();
+	}
+    }
+
+    void unjoin( Context *joiner )
+    {
+	for(int i = 0; i < m_joiners.size(); i++)
+	{
+	    if(m_joiners[i] == joiner)
+	    {
+		m_joiners.erase(m_joiners.begin() + i);
+		return;
+	    }
+	}
+    }
+
     void wait( int64_t howmuch )
     {
 //	m_sim->schedule_wait(this, howmuch);
@@ -364,21 +1044,51 @@ public:
 
 	m_wait_until = m_sim->m_time + howmuch;
 	m_state = WAITING_TIME;
+	m_sim->schedule_timer(this, m_wait_until);
 	m_cofunc.Yield();
     }
 
+    // suspends until e is notified
+    void wait( Event& e )
+    {
+	m_sim->attach(e);
+	e.m_waiters.push_back(this);
+	suspend();
+    }
+
+    void notify( Event& e )
+    {
+	m_sim->notify(e);
+    }
+
+    // 0: next delta
+    void notify( Event& e, int64_t delay )
+    {
+	m_sim->notify(e, delay);
+    }
+
     void wait_signal( SigBase& sig )
     {
-	m_wait_signals.insert(&sig);
-	m_state = WAITING_EVENT;
-	m_cofunc.Yield();
+	m_wait_signals.clear();
+	m_wait_signals.push_back(&sig);
+	block(c_noTimeout);
     }
 
     void wait_signal( const std::set<SigBase*>& list )
     {
-	m_wait_signals = list;
-	m_state = WAITING_EVENT;
-	m_cofunc.Yield();
+	m_wait_signals.assign(list.begin(), list.end());
+	block(c_noTimeout);
+    }
+
+    /**
+     * Function wait_signal()
+     * Waits for a change of any signal in list, for at most timeout time
+     * units. Returns WAKE_SIGNAL (m_trigger is the signal) or WAKE_TIMEOUT.
+     */
+    WakeReason wait_signal( const std::set<SigBase*>& list, int64_t timeout )
+    {
+	m_wait_signals.assign(list.begin(), list.end());
+	return block( deadline(timeout) );
     }
 
     void wait_posedge ( Logic& sig )
@@ -389,17 +1099,131 @@ public:
 	} while (!sig.pos_edge());
     }
 
+    // waits for a rising edge of sig for at most timeout: WAKE_EDGE or WAKE_TIMEOUT
+    WakeReason wait_posedge( Logic& sig, int64_t timeout )
+    {
+	int64_t until = deadline(timeout);
+
+	m_wait_signals.clear();
+	m_wait_signals.push_back(&sig);
+
+	do
+	{
+	    if( block(until) == WAKE_TIMEOUT )
+		return WAKE_TIMEOUT;
+	} while (!sig.pos_edge());
+
+	return WAKE_EDGE;
+    }
+
+    /**
+     * Function wait_any()
+     * Waits for whichever comes first: a change of a signal in signals
+     * (WAKE_SIGNAL), a rising edge of a signal in edges (WAKE_EDGE) or
+     * timeout time units (WAKE_TIMEOUT, c_noTimeout for none). m_trigger is
+     * the signal that woke the process, NULL on timeout.
+     */
+    WakeReason wait_any( const std::set<SigBase*>& signals, const std::set<Logic*>& edges,
+			 int64_t timeout = c_noTimeout )
+    {
+	int64_t until = deadline(timeout);
+
+	m_wait_signals.assign(signals.begin(), signals.end());
+	m_wait_signals.insert(m_wait_signals.end(), edges.begin(), edges.end());
+
+	for(;;)
+	{
+	    if( block(until) == WAKE_TIMEOUT )
+		return WAKE_TIMEOUT;
+
+	    BOOST_FOREACH(SigBase *s, signals)
+	    {
+		if(s->changed())
+		{
+		    m_trigger = s;
+		    return WAKE_SIGNAL;
+		}
+	    }
+
+	    BOOST_FOREACH(Logic *l, edges)
+	    {
+		if(l->pos_edge())
+		{
+		    m_trigger = l;
+		    return WAKE_EDGE;
+		}
+	    }
+
+	    // only falling edges
+	    m_wait_signals.assign(signals.begin(), signals.end());
+	    m_wait_signals.insert(m_wait_signals.end(), edges.begin(), edges.end());
+	}
+    }
+
+    // sleeps until another process calls Simulation::wake() for this one
+    void suspend()
+    {
+	m_state = SUSPENDED;
+	m_cofunc.Yield();
+    }
+
     void finish()
     {
 	m_state = DONE;
     }
 
+    int64_t deadline( int64_t timeout ) const
+    {
+	return timeout == c_noTimeout ? c_noTimeout : m_sim->m_time + timeout;
+    }
+
+    // waits on m_wait_signals until deadline (c_noTimeout: no deadline)
+    WakeReason block( int64_t deadline )
+    {
+	m_state = WAITING_EVENT;
+	m_hasTimeout = deadline != c_noTimeout;
+	m_trigger = NULL;
+
+	if(m_hasTimeout)
+	{
+	    m_wait_until = deadline;
+	    m_sim->schedule_timer(this, deadline);
+	}
+
+	m_cofunc.Yield();
+	return m_wakeReason;
+    }
+
     State m_state;
     COROUTINE<int, Context*> m_cofunc;
     Simulation *m_sim;
-    std::set<SigBase *> m_wait_signals;
+    // a vector, so that waiting reuses its storage instead of allocating
+    std::vector<SigBase *> m_wait_signals;
     uint64_t m_wait_until;
+    // WAITING_EVENT with a deadline in m_wait_until
+    bool m_hasTimeout;
+    // bumped on every wakeup, invalidating armed timers
+    uint64_t m_timerGen;
+    WakeReason m_wakeReason;
+    SigBase *m_trigger;
     string m_name;
+    void *m_arg;
+    // set for processes registered with add_clock/add_clocked_process/add_comb_process
+    Simulation::CycleProcess *m_cycle;
+
+    // spawned: recycled when the process returns
+    bool m_pooled;
+    // index in Simulation::m_ctxs, -1 until the first start
+    int m_slot;
+    // bumped on every spawn() reusing this Context
+    uint64_t m_run;
+    // processes suspended in join()/join_any() on this one
+    std::vector<Context *> m_joiners;
 };
 
+inline bool Process::done() const
+{
+    return m_ctx->m_run != m_run || m_ctx->m_state == Context::DONE;
+}
+
 #endif
@@ -0,0 +1,60 @@
+#include "telemetry.h"
+
+// attaches to the telemetry page of a running simulation and prints its
+// statistics until the simulation ends
+
+static const char *c_stateNames[TelemetryPage::c_states] = { "idle", "wait_time", "wait_event", "done", "cont", "susp" };
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2 || argc > 3)
+    {
+	fprintf(stderr, "usage: %s stats_file [interval_seconds]\n", argv[0]);
+	return 1;
+    }
+
+    double interval = argc == 3 ? atof(argv[2]) : 1.0;
+    int fd = open( argv[1], O_RDONLY );
+
+    if(fd < 0)
+    {
+	fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[1]);
+	return 1;
+    }
+
+    void *p = mmap( NULL, sizeof(TelemetryPage), PROT_READ, MAP_SHARED, fd, 0 );
+    close(fd);
+
+    const TelemetryPage *page = (const TelemetryPage *) p;
+
+    if(p == MAP_FAILED || page->m_magic != TelemetryPage::c_magic)
+    {
+	fprintf(stderr, "%s: %s is not a simulation stats file\n", argv[0], argv[1]);
+	return 1;
+    }
+
+    for(;;)
+    {
+	TelemetryPage s;
+
+	if( !Telemetry::read(page, s) )
+	    continue;
+
+	printf("pid %lld  wall %8.1fs  time %12lld (%.3g/s)  events %.3g/s  deltas %.3g/s  rss %llu MB ",
+	       (long long) s.m_pid, s.m_wallTime, (long long) s.m_simTime, s.m_timeRate,
+	       s.m_eventRate, s.m_deltaRate, (unsigned long long) (s.m_rss >> 20));
+
+	for(int i = 0; i < TelemetryPage::c_states; i++)
+	    if(s.m_processes[i])
+		printf(" %s %u", c_stateNames[i], s.m_processes[i]);
+	printf("\n");
+	fflush(stdout);
+
+	if(!s.m_running)
+	    break;
+
+	usleep( interval * 1e6 );
+    }
+
+    return 0;
+}
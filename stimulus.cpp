@@ -0,0 +1,266 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include "stimulus.h"
+
+static const char c_vectorMagic[8] = "SIMVEC1";
+
+VectorFile::VectorFile( const std::string filename )
+{
+    struct stat st;
+    int fd = open( filename.c_str(), O_RDONLY );
+
+    if(fd < 0 || fstat(fd, &st) < 0)
+	throw std::runtime_error("VectorFile: can't open " + filename);
+
+    m_mapSize = st.st_size;
+    m_map = mmap( NULL, m_mapSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close(fd);
+
+    if(m_map == MAP_FAILED)
+	throw std::runtime_error("VectorFile: can't map " + filename);
+
+    // rows are consumed front to back, let the kernel read ahead
+    madvise( m_map, m_mapSize, MADV_SEQUENTIAL );
+
+    m_header = reinterpret_cast<const VectorFileHeader *>( m_map );
+
+    if( m_mapSize < sizeof(VectorFileHeader) || memcmp(m_header->m_magic, c_vectorMagic, 8) ||
+	m_mapSize < sizeof(VectorFileHeader) + m_header->m_columns * ( c_nameLength + m_header->m_rows * sizeof(uint64_t) ) )
+    {
+	munmap( m_map, m_mapSize );
+	throw std::runtime_error("VectorFile: " + filename + " is not a valid vector file");
+    }
+
+    const char *names = reinterpret_cast<const char *>( m_header + 1 );
+    m_data = reinterpret_cast<const uint64_t *>( names + m_header->m_columns * c_nameLength );
+}
+
+VectorFile::~VectorFile()
+{
+    munmap( m_map, m_mapSize );
+}
+
+int VectorFile::column( const std::string name ) const
+{
+    const char *names = reinterpret_cast<const char *>( m_header + 1 );
+
+    for(int i = 0; i < m_header->m_columns; i++)
+	if( !strncmp( names + i * c_nameLength, name.c_str(), c_nameLength ) )
+	    return i;
+
+    return -1;
+}
+
+bool VectorFile::convert_csv( const std::string csv_file, const std::string vec_file )
+{
+    FILE *in = fopen( csv_file.c_str(), "r" );
+    if(!in)
+	return false;
+
+    FILE *out = fopen( vec_file.c_str(), "wb" );
+    if(!out)
+    {
+	fclose(in);
+	return false;
+    }
+
+    VectorFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.m_magic, c_vectorMagic, 8);
+
+    bool ok = true, have_names = false;
+    std::vector<uint64_t> row;
+    char line[4096];
+
+    while( ok && fgets(line, sizeof(line), in) )
+    {
+	char *p = line, *tok;
+
+	if( line[strspn(line, " \t\r\n")] == 0 )
+	    continue;
+
+	if(!have_names)
+	{
+	    // first line: the column names
+	    std::vector<std::string> names;
+
+	    while( (tok = strsep(&p, ",")) != NULL )
+	    {
+		tok += strspn(tok, " \t\r\n");
+		tok[strcspn(tok, " \t\r\n")] = 0;
+		names.push_back(tok);
+	    }
+
+	    hdr.m_columns = names.size();
+	    fwrite(&hdr, sizeof(hdr), 1, out);
+
+	    BOOST_FOREACH(const std::string& name, names)
+	    {
+		char buf[c_nameLength];
+		memset(buf, 0, c_nameLength);
+		strncpy(buf, name.c_str(), c_nameLength - 1);
+		fwrite(buf, c_nameLength, 1, out);
+	    }
+
+	    have_names = true;
+	    continue;
+	}
+
+	row.clear();
+
+	while( (tok = strsep(&p, ",")) != NULL )
+	{
+	    char *end;
+	    tok += strspn(tok, " \t\r\n");
+	    tok[strcspn(tok, " \t\r\n")] = 0;
+	    row.push_back( strtoull(tok, &end, 0) );
+	    ok = ok && *tok && !*end;
+	}
+
+	ok = ok && row.size() == hdr.m_columns;
+	fwrite(&row[0], sizeof(uint64_t), row.size(), out);
+	hdr.m_rows++;
+    }
+
+    ok = ok && hdr.m_columns > 0;
+
+    // now that we know the number of rows
+    fseek(out, 0, SEEK_SET);
+    fwrite(&hdr, sizeof(hdr), 1, out);
+
+    fclose(in);
+    ok = !fclose(out) && ok;
+    return ok;
+}
+
+
+StimulusDriver::StimulusDriver( Simulation *sim, const std::string filename, Logic *clk, int64_t period ) :
+    m_file( filename ), m_sim( sim ), m_clk( clk ), m_period( period ), m_row( 0 )
+{
+    assert( clk || period > 0 );
+    sim->add_process( process, "stimulus:" + filename, false, this );
+}
+
+bool StimulusDriver::bind( const std::string column, Logic *sig )
+{
+    int col = m_file.column(column);
+
+    if(col < 0)
+	return false;
+
+    m_bindings.push_back( std::make_pair(col, sig) );
+    return true;
+}
+
+int StimulusDriver::bind_all()
+{
+    int n = 0;
+
+    BOOST_FOREACH(SigBase *s, m_sim->m_signals)
+	if( Logic *l = dynamic_cast<Logic *>(s) )
+	    n += bind( l->name(), l ) ? 1 : 0;
+
+    return n;
+}
+
+int StimulusDriver::process( Context *c )
+{
+    StimulusDriver *drv = static_cast<StimulusDriver *>( c->m_arg );
+
+    while( !drv->done() )
+    {
+	if(drv->m_clk)
+	    c->wait_posedge(*drv->m_clk);
+
+	const uint64_t *row = drv->m_file.row( drv->m_row++ );
+
+	for(int i = 0; i < drv->m_bindings.size(); i++)
+	{
+	    Logic *sig = drv->m_bindings[i].second;
+
+	    c->assign( *sig, LogicValue( sig->m_bits, row[ drv->m_bindings[i].first ] ) );
+	}
+
+	if(!drv->m_clk)
+	    c->wait(drv->m_period);
+    }
+
+    c->finish();
+    return 0;
+}
+
+
+ResponseChecker::ResponseChecker( Simulation *sim, const std::string filename, Logic *clk,
+				  Logic *strobe, int latency ) :
+    m_maxReports( 10 ), m_file( filename ), m_sim( sim ), m_clk( clk ), m_strobe( strobe ),
+    m_latency( latency ), m_row( 0 ), m_errors( 0 )
+{
+    sim->add_process( process, "checker:" + filename, false, this );
+}
+
+bool ResponseChecker::bind( const std::string column, Logic *sig )
+{
+    int col = m_file.column(column);
+
+    if(col < 0)
+	return false;
+
+    m_bindings.push_back( std::make_pair(col, sig) );
+    return true;
+}
+
+int ResponseChecker::bind_all()
+{
+    int n = 0;
+
+    BOOST_FOREACH(SigBase *s, m_sim->m_signals)
+	if( Logic *l = dynamic_cast<Logic *>(s) )
+	    n += bind( l->name(), l ) ? 1 : 0;
+
+    return n;
+}
+
+int ResponseChecker::process( Context *c )
+{
+    ResponseChecker *chk = static_cast<ResponseChecker *>( c->m_arg );
+    int edges = 0;
+
+    while( chk->m_row < chk->m_file.rows() )
+    {
+	c->wait_posedge(*chk->m_clk);
+
+	if(chk->m_strobe)
+	{
+	    if(!chk->m_strobe->value())
+		continue;
+	} else if(edges++ < chk->m_latency)
+	    continue;
+
+	const uint64_t *row = chk->m_file.row( chk->m_row );
+
+	for(int i = 0; i < chk->m_bindings.size(); i++)
+	{
+	    Logic *sig = chk->m_bindings[i].second;
+	    uint64_t expected = row[ chk->m_bindings[i].first ] & sig->mask();
+
+	    if( sig->value() == expected )
+		continue;
+
+	    if( chk->m_errors++ < chk->m_maxReports )
+		printf("%-8lld: %s = 0x%llx, expected 0x%llx (row %llu)\n", (long long) c->m_sim->m_time,
+		       sig->name().c_str(), (unsigned long long) sig->value(),
+		       (unsigned long long) expected, (unsigned long long) chk->m_row);
+	}
+
+	chk->m_row++;
+    }
+
+    c->finish();
+    return 0;
+}
@@ -0,0 +1,143 @@
+#ifndef __STIMULUS_H
+#define __STIMULUS_H
+
+#include "sim.h"
+
+/*
+ Batched stimulus streaming and response checking.
+
+ Vectors live in a binary file (convert CSV with VectorFile::convert_csv() or
+ the vecconv tool), which is memory-mapped and consumed in place: one row per
+ clock edge (or per fixed period), one uint64 per column. A single process
+ applies all rows; nothing is parsed once the simulation runs.
+
+ File layout (host endianness):
+   VectorFileHeader
+   m_columns x char[c_nameLength]   - column names, zero padded
+   m_rows x m_columns x uint64_t    - values, row-major
+*/
+
+struct VectorFileHeader
+{
+    char m_magic[8];
+    uint32_t m_columns;
+    uint32_t m_reserved;
+    uint64_t m_rows;
+};
+
+class VectorFile
+{
+public:
+    static const int c_nameLength = 32;
+
+    VectorFile( const std::string filename );
+    ~VectorFile();
+
+    // index of the named column, -1 if there is none
+    int column( const std::string name ) const;
+
+    int columns() const
+    {
+	return m_header->m_columns;
+    }
+
+    uint64_t rows() const
+    {
+	return m_header->m_rows;
+    }
+
+    const uint64_t *row( uint64_t n ) const
+    {
+	return m_data + n * m_header->m_columns;
+    }
+
+    /**
+     * Function convert_csv()
+     * Converts a CSV file (header line with column names, then one row of
+     * decimal or 0x-prefixed hex integers per line) into a vector file.
+     * @return false on I/O or syntax errors.
+     */
+    static bool convert_csv( const std::string csv_file, const std::string vec_file );
+
+private:
+    const VectorFileHeader *m_header;
+    const uint64_t *m_data;
+    void *m_map;
+    size_t m_mapSize;
+};
+
+/**
+ * Class StimulusDriver
+ * Applies one row of a vector file to the bound signals on each rising edge of
+ * clk or, without a clock, every period time units starting at time 0.
+ */
+class StimulusDriver
+{
+public:
+    StimulusDriver( Simulation *sim, const std::string filename, Logic *clk, int64_t period = 0 );
+
+    // drives sig from the named column; false if there is no such column
+    bool bind( const std::string column, Logic *sig );
+    // binds every column named after one of the simulation's signals
+    int bind_all();
+
+    bool done() const
+    {
+	return m_row >= m_file.rows();
+    }
+
+    VectorFile m_file;
+
+private:
+    static int process( Context *c );
+
+    Simulation *m_sim;
+    Logic *m_clk;
+    int64_t m_period;
+    uint64_t m_row;
+    std::vector< std::pair<int, Logic *> > m_bindings;
+};
+
+/**
+ * Class ResponseChecker
+ * Compares the bound signals against one row of expected values on each
+ * rising edge of clk. Without a strobe, comparison starts after latency
+ * edges (1: the outputs settled from the row applied at the previous edge);
+ * with a strobe signal, a row is consumed only on edges where it is high.
+ */
+class ResponseChecker
+{
+public:
+    ResponseChecker( Simulation *sim, const std::string filename, Logic *clk,
+		     Logic *strobe = NULL, int latency = 1 );
+
+    bool bind( const std::string column, Logic *sig );
+    int bind_all();
+
+    uint64_t checked() const
+    {
+	return m_row;
+    }
+
+    uint64_t errors() const
+    {
+	return m_errors;
+    }
+
+    // number of mismatches printed before going quiet
+    int m_maxReports;
+
+    VectorFile m_file;
+
+private:
+    static int process( Context *c );
+
+    Simulation *m_sim;
+    Logic *m_clk, *m_strobe;
+    int m_latency;
+    uint64_t m_row;
+    uint64_t m_errors;
+    std::vector< std::pair<int, Logic *> > m_bindings;
+};
+
+#endif
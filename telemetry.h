@@ -0,0 +1,212 @@
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include <ctime>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "sim.h"
+
+/*
+ Live run statistics in a shared memory page (e.g. /dev/shm/sim.stats),
+ for simstat or any other reader that maps the file.
+
+ The kernel calls Telemetry::end_step() at the end of every time step. That
+ is a countdown; every c_checkSteps steps the coarse monotonic clock is read
+ and, once per interval, a snapshot is published. Readers never block the
+ simulation: the page is a seqlock - m_seq is odd while the writer updates
+ the page, and a reader retries if m_seq was odd or changed during its copy.
+*/
+
+struct TelemetryPage
+{
+    static const uint32_t c_magic = 0x53494d53;	// "SIMS"
+    static const int c_states = 6;		// Context::State values
+
+    uint32_t m_magic;
+    uint32_t m_running;		// cleared when the simulation is over
+    std::atomic<uint64_t> m_seq;
+
+    int64_t m_pid;
+    int64_t m_simTime;
+    double m_wallTime;		// seconds since the start
+    double m_timeRate;		// simulated time units per second
+    double m_eventRate;		// committed signal changes per second
+    double m_deltaRate;		// delta cycles per second
+    uint64_t m_events, m_deltas, m_steps;
+    uint32_t m_processes[c_states];	// processes per Context::State
+    uint64_t m_rss;		// resident memory, bytes
+    uint64_t m_publishes;
+};
+
+class Telemetry
+{
+public:
+    static const int c_checkSteps = 256;
+
+    // interval: publish period in seconds
+    Telemetry( Simulation *sim, const std::string filename, double interval = 0.1 ) :
+	m_sim( sim ), m_interval( interval ), m_countdown( c_checkSteps ), m_page( NULL ), m_statm( -1 ),
+	m_start( now() ), m_last( m_start ), m_lastTime( sim->m_time ),
+	m_lastEvents( sim->m_events ), m_lastDeltas( sim->m_deltas )
+    {
+	int fd = open( filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+
+	// not ok(): the simulation runs without telemetry
+	if(fd < 0)
+	    return;
+
+	if(ftruncate( fd, sizeof(TelemetryPage) ) == 0)
+	{
+	    void *p = mmap( NULL, sizeof(TelemetryPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+
+	    if(p != MAP_FAILED)
+		m_page = (TelemetryPage *) p;
+	}
+	close(fd);
+
+	m_statm = open( "/proc/self/statm", O_RDONLY );
+
+	if(m_page)
+	{
+	    memset( (void *) m_page, 0, sizeof(TelemetryPage) );
+	    m_page->m_pid = getpid();
+	    m_page->m_running = 1;
+	    m_page->m_magic = TelemetryPage::c_magic;
+	    sim->m_telemetry = this;
+	}
+    }
+
+    ~Telemetry()
+    {
+	if(m_page)
+	{
+	    publish( now() );
+	    m_page->m_running = 0;
+	    munmap( m_page, sizeof(TelemetryPage) );
+	    m_sim->m_telemetry = NULL;
+	}
+
+	if(m_statm >= 0)
+	    close(m_statm);
+    }
+
+    bool ok() const
+    {
+	return m_page != NULL;
+    }
+
+    void end_step()
+    {
+	if(--m_countdown)
+	    return;
+
+	m_countdown = c_checkSteps;
+
+	double t = now();
+	if(t - m_last >= m_interval)
+	    publish(t);
+    }
+
+    void publish( double t )
+    {
+	TelemetryPage *p = m_page;
+	double dt = t - m_last;
+
+	uint64_t seq = p->m_seq.load( std::memory_order_relaxed );
+	p->m_seq.store( seq + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+
+	p->m_simTime = m_sim->m_time;
+	p->m_wallTime = t - m_start;
+	p->m_events = m_sim->m_events;
+	p->m_deltas = m_sim->m_deltas;
+	p->m_steps = m_sim->m_steps;
+
+	if(dt > 0)
+	{
+	    p->m_timeRate = (m_sim->m_time - m_lastTime) / dt;
+	    p->m_eventRate = (m_sim->m_events - m_lastEvents) / dt;
+	    p->m_deltaRate = (m_sim->m_deltas - m_lastDeltas) / dt;
+	}
+
+	memset( p->m_processes, 0, sizeof(p->m_processes) );
+	BOOST_FOREACH(Context *ctx, m_sim->m_ctxs)
+	    p->m_processes[ ctx->m_state ]++;
+
+	p->m_rss = rss();
+	p->m_publishes++;
+
+	p->m_seq.store( seq + 2, std::memory_order_release );
+
+	m_last = t;
+	m_lastTime = m_sim->m_time;
+	m_lastEvents = m_sim->m_events;
+	m_lastDeltas = m_sim->m_deltas;
+    }
+
+    /**
+     * Function read()
+     * Consistent copy of a (possibly live) page into snap. Returns false if
+     * the writer kept it busy for too long.
+     */
+    static bool read( const TelemetryPage *page, TelemetryPage& snap )
+    {
+	for(int tries = 0; tries < 1000; tries++)
+	{
+	    uint64_t seq = page->m_seq.load( std::memory_order_acquire );
+
+	    if(seq & 1)
+		continue;
+
+	    memcpy( (void *) &snap, (const void *) page, sizeof(TelemetryPage) );
+	    std::atomic_thread_fence( std::memory_order_acquire );
+
+	    if(page->m_seq.load( std::memory_order_relaxed ) == seq)
+		return true;
+	}
+
+	return false;
+    }
+
+private:
+    static double now()
+    {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC_COARSE, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    uint64_t rss() const
+    {
+	char buf[64];
+	long size, resident;
+
+	if(m_statm < 0)
+	    return 0;
+
+	int n = pread( m_statm, buf, sizeof(buf) - 1, 0 );
+	if(n <= 0)
+	    return 0;
+	buf[n] = 0;
+
+	if(sscanf( buf, "%ld %ld", &size, &resident ) != 2)
+	    return 0;
+
+	return (uint64_t) resident * sysconf(_SC_PAGESIZE);
+    }
+
+    Simulation *m_sim;
+    double m_interval;
+    int m_countdown;
+    TelemetryPage *m_page;
+    int m_statm;
+
+    double m_start, m_last;
+    int64_t m_lastTime;
+    uint64_t m_lastEvents, m_lastDeltas;
+};
+
+#endif
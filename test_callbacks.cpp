@@ -0,0 +1,89 @@
+#include "sim.h"
+
+/*
+ Observes a counter through value change callbacks instead of processes:
+ a per-signal callback checks every increment, a step callback sees the
+ same changes batched per time step. A one-shot callback removes itself
+ from within its first call.
+*/
+
+Logic clk_i(1,"clk_i");
+Logic counter(8,"counter");
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk_i, ~clk_i );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk_i);
+	c->assign(counter, counter + LogicValue(8, 1));
+    }
+}
+
+int n_changes, n_errors, n_steps, n_batched, n_oneshot;
+Simulation *g_sim;
+
+void on_counter( const ValueChange& vc, void *arg )
+{
+    n_changes++;
+
+    if( vc.m_new != ((vc.m_old + 1) & 0xff) || vc.m_time % 20 )
+    {
+	printf("%-8lld: unexpected change %llu -> %llu\n", (long long) vc.m_time,
+	       (unsigned long long) vc.m_old, (unsigned long long) vc.m_new);
+	n_errors++;
+    }
+}
+
+// sees the first increment only
+void on_oneshot( const ValueChange& vc, void *arg )
+{
+    n_oneshot++;
+    g_sim->remove_value_callback(vc.m_sig, on_oneshot, arg);
+}
+
+void on_step( int64_t time, const std::vector<ValueChange>& changes, void *arg )
+{
+    n_steps++;
+
+    BOOST_FOREACH(const ValueChange& vc, changes)
+	if(vc.m_sig == arg)
+	    n_batched++;
+}
+
+int main()
+{
+    Simulation sim;
+
+    g_sim = &sim;
+
+    sim.add_signal(&clk_i);
+    sim.add_signal(&counter);
+
+    clk_i.initial( LogicValue(1, 0) );
+    counter.initial( LogicValue(8, 0) );
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_counter, "counter", false);
+
+    sim.add_value_callback(&counter, on_oneshot);
+    sim.add_value_callback(&counter, on_counter);
+    sim.add_step_callback(on_step, &counter);
+
+    printf("Running simulation...\n");
+
+    sim.run(400);
+
+    printf("%d changes (should be 20), %d batched in %d steps, %d errors, one-shot called %d times\n", n_changes, n_batched, n_steps, n_errors, n_oneshot);
+
+    return (n_changes == 20 && n_batched == n_changes && !n_errors && n_oneshot == 1) ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include "sim.h"
+#include "channel.h"
+
+/*
+ Two producers send bursts of packets through a bounded FIFO to one
+ consumer. A semaphore keeps the bursts from interleaving. Packets carry a
+ heap payload and count their copies - there must be none. Putting an
+ lvalue copies it and leaves it intact.
+*/
+
+int n_copies;
+
+struct Packet
+{
+    Packet() {}
+    Packet( const Packet& b ) : m_src( b.m_src ), m_seq( b.m_seq ), m_payload( b.m_payload ) { n_copies++; }
+    Packet( Packet&& b ) = default;
+    Packet& operator=( Packet&& b ) = default;
+
+    int m_src, m_seq;
+    std::vector<uint8_t> m_payload;
+};
+
+const int n_bursts = 50, burst_length = 5;
+
+Fifo<Packet> fifo(4);
+Semaphore bus(1);
+int n_errors, n_received;
+
+int proc_producer(Context *c)
+{
+    int src = *static_cast<int *>(c->m_arg);
+
+    for(int b = 0; b < n_bursts; b++)
+    {
+	bus.get(c);
+
+	for(int i = 0; i < burst_length; i++)
+	{
+	    Packet p;
+	    p.m_src = src;
+	    p.m_seq = b * burst_length + i;
+	    p.m_payload.assign(1500, (uint8_t) p.m_seq);
+	    fifo.put(c, std::move(p));
+	}
+
+	bus.put();
+	c->wait(1);
+    }
+
+    c->finish();
+    return 0;
+}
+
+int proc_consumer(Context *c)
+{
+    for(;;)
+    {
+	Packet first = fifo.get(c);
+
+	for(int i = 1; i < burst_length; i++)
+	{
+	    Packet p = fifo.get(c);
+
+	    if(p.m_src != first.m_src || p.m_seq != first.m_seq + i || p.m_payload[1499] != (uint8_t) p.m_seq)
+		n_errors++;
+	}
+
+	n_received += burst_length;
+
+	// slow consumer: the producers block on the full FIFO
+	c->wait(3);
+    }
+    return 0;
+}
+
+int main()
+{
+    Simulation sim;
+    int src_a = 0, src_b = 1;
+
+    sim.add_process(proc_producer, "producer_a", false, &src_a);
+    sim.add_process(proc_producer, "producer_b", false, &src_b);
+    sim.add_process(proc_consumer, "consumer", false);
+
+    printf("Running simulation...\n");
+
+    sim.run(1000);
+
+    printf("%d packets received (should be %d), %d errors, %d copies\n", n_received, 2 * n_bursts * burst_length, n_errors, n_copies);
+
+    bool ok = n_received == 2 * n_bursts * burst_length && !n_errors && !n_copies;
+
+    Mailbox<Packet> mbox;
+    Packet kept;
+
+    kept.m_payload.assign(1500, 0);
+    mbox.try_put(kept);
+
+    printf("lvalue put: %d copies (should be 1), %d bytes kept (should be 1500)\n", n_copies, (int) kept.m_payload.size());
+
+    return (ok && n_copies == 1 && kept.m_payload.size() == 1500) ? 0 : 1;
+}
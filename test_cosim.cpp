@@ -0,0 +1,170 @@
+#include <thread>
+
+#include "sim.h"
+
+/*
+ Lockstep co-simulation with a software model on another thread. The
+ "CPU" thread injects a write request for every transaction, advances the
+ simulation past it and reads back the accumulator the RTL keeps. Helper
+ threads post callbacks concurrently to exercise the inbox. A second,
+ purely reactive design (no clock, nothing scheduled between injections)
+ is driven by a partner that polls reached() without ever sleeping.
+*/
+
+Logic clk(1,"clk");
+Logic wr_valid(1,"wr_valid");
+Logic wr_data(32,"wr_data");
+Logic acc(32,"acc");
+
+const int64_t period = 20;
+const int n_transactions = 2000;
+const int n_helpers = 3;
+const int n_calls = 10000;
+
+std::atomic<int> n_calls_run(0);
+
+Logic req(32,"req");
+Logic resp(32,"resp");
+
+const int n_requests = 100000;
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(period / 2);
+    }
+    return 0;
+}
+
+// accumulates wr_data on every rising edge with wr_valid set
+int proc_acc(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk);
+
+	if(wr_valid.value())
+	    c->assign(acc, acc + wr_data);
+    }
+}
+
+// resp follows req combinationally
+int proc_echo(Context *c)
+{
+    for(;;)
+    {
+	c->wait_signal(req);
+	c->assign(resp, req + LogicValue(32, 1));
+    }
+}
+
+int reactive()
+{
+    Simulation sim;
+
+    sim.add_signal(&req);
+    sim.add_signal(&resp);
+    req.initial(LogicValue(32, 0));
+    resp.initial(LogicValue(32, 1));
+
+    sim.add_process(proc_echo, "echo", false);
+    sim.enable_lockstep();
+
+    std::thread rtl( &Simulation::run, &sim, (int64_t) n_requests + 2, Simulation::EVENT_DRIVEN );
+    int n_errors = 0;
+
+    for(int i = 1; i <= n_requests; i++)
+    {
+	sim.inject( i, req, LogicValue(32, i) );
+	sim.grant( i + 1 );
+
+	// no backoff, only yield the CPU to a kernel thread sharing it
+	while(sim.reached() < i + 1)
+	    std::this_thread::yield();
+
+	// the step at i is done: resp must already answer the request
+	if(resp.value() != i + 1)
+	    n_errors++;
+    }
+
+    sim.release_lockstep();
+    rtl.join();
+
+    printf("reactive: %d requests, %d stale responses\n", n_requests, n_errors);
+    return n_errors;
+}
+
+void count_call( Simulation *sim, void *arg )
+{
+    n_calls_run++;
+}
+
+void helper( Simulation *sim )
+{
+    for(int i = 0; i < n_calls; i++)
+	sim->inject_call( 0, count_call, NULL );
+}
+
+int main()
+{
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&wr_valid);
+    sim.add_signal(&wr_data);
+    sim.add_signal(&acc);
+
+    clk.initial(LogicValue(1, 0));
+    wr_valid.initial(LogicValue(1, 0));
+    wr_data.initial(LogicValue(32, 0));
+    acc.initial(LogicValue(32, 0));
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_acc, "acc", false);
+
+    sim.enable_lockstep();
+
+    printf("Running simulation...\n");
+
+    const int64_t end = (n_transactions + 4) * period;
+    std::thread rtl( &Simulation::run, &sim, end, Simulation::EVENT_DRIVEN );
+
+    std::vector<std::thread> helpers;
+    for(int i = 0; i < n_helpers; i++)
+	helpers.push_back( std::thread(helper, &sim) );
+
+    int n_errors = 0;
+    uint32_t expected = 0;
+
+    for(int i = 0; i < n_transactions; i++)
+    {
+	// drive the request between two rising edges, sampled at the next one
+	int64_t t = i * period + period / 2;
+
+	sim.inject( t, wr_valid, LogicValue(1, 1) );
+	sim.inject( t, wr_data, LogicValue(32, i * 3) );
+	sim.inject( t + period, wr_valid, LogicValue(1, 0) );
+
+	// past the sampling edge: the simulation is blocked, acc is safe to read
+	sim.advance_to( t + period / 2 + 1 );
+	expected += i * 3;
+
+	if(acc.value() != expected)
+	    n_errors++;
+    }
+
+    BOOST_FOREACH(std::thread& h, helpers)
+	h.join();
+
+    sim.release_lockstep();
+    rtl.join();
+
+    printf("acc %u (should be %u), %d calls (should be %d), %d errors\n",
+	   (unsigned) acc.value(), expected, n_calls_run.load(), n_helpers * n_calls, n_errors);
+
+    n_errors += reactive();
+
+    return (!n_errors && acc.value() == expected && n_calls_run == n_helpers * n_calls) ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+#include "sim.h"
+#include "coverage.h"
+
+/*
+ A 4-bit counter with toggle and value/transition coverage, a 16-bit
+ counter that wraps often enough to flush the bit-sliced counters, and a
+ stuck signal. Two runs are written as databases and merged.
+*/
+
+Logic clk(1,"clk");
+Logic state(4,"state");
+Logic wide(16,"wide");
+Logic stuck(8,"stuck");
+
+const int n_cycles = 1000;
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_count(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk);
+	c->assign(state, state + LogicValue(4, 1));
+	c->assign(wide, wide + LogicValue(16, 1));
+    }
+}
+
+static bool run( const char *filename )
+{
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&state);
+    sim.add_signal(&wide);
+    sim.add_signal(&stuck);
+
+    clk.initial(LogicValue(1, 0));
+    state.initial(LogicValue(4, 0));
+    wide.initial(LogicValue(16, 0));
+    stuck.initial(LogicValue(8, 0x5a));
+
+    Coverage cov(&sim);
+
+    cov.track_all();
+    cov.track_values(&state, true);
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_count, "count", false);
+
+    sim.run(n_cycles * 20);
+
+    return cov.write(filename);
+}
+
+static const CoverageEntry *find( const CoverageDB& db, const std::string name )
+{
+    BOOST_FOREACH(const CoverageEntry& e, db.m_entries)
+	if(e.m_name == name)
+	    return &e;
+    return NULL;
+}
+
+int main()
+{
+    int n_errors = 0;
+
+    printf("Running simulation...\n");
+
+    if( !run("test_coverage1.cov") || !run("test_coverage2.cov") )
+    {
+	printf("cannot write the coverage databases\n");
+	return 1;
+    }
+
+    CoverageDB db, db2;
+
+    if( !db.load("test_coverage1.cov") || !db2.load("test_coverage2.cov") || !db.merge(db2) )
+    {
+	printf("cannot read the coverage databases\n");
+	return 1;
+    }
+
+    db.report(stdout);
+
+    const CoverageEntry *s = find(db, "state"), *w = find(db, "wide"), *k = find(db, "stuck");
+
+    if(!s || !w || !k || s->m_values.size() != 16 || s->m_transitions.size() != 256)
+    {
+	printf("missing coverage entries\n");
+	return 1;
+    }
+
+    // n_cycles rising edges per run, bit b of a counter rises every 2^(b+1) edges
+    for(int b = 0; b < 16; b++)
+    {
+	uint64_t expected = 2 * ( (n_cycles + (1 << b)) >> (b + 1) );
+
+	if( w->m_rise[b] != expected )
+	{
+	    printf("wide[%d]: %llu rises (should be %llu)\n", b, (unsigned long long) w->m_rise[b], (unsigned long long) expected);
+	    n_errors++;
+	}
+    }
+
+    for(int v = 0; v < 16; v++)
+    {
+	if( !s->m_values[v] || !s->m_transitions[v * 16 + ((v + 1) & 15)] )
+	    n_errors++;
+	if( s->m_transitions[v * 16 + ((v + 2) & 15)] )
+	    n_errors++;
+    }
+
+    for(int b = 0; b < 8; b++)
+	if( k->m_rise[b] || k->m_fall[b] )
+	    n_errors++;
+
+    printf("%d errors\n", n_errors);
+
+    return n_errors ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+#include "sim.h"
+
+/*
+ The divider from test_divide.cpp written as clocked and combinational
+ processes, run once with the event-driven engine and once with the
+ cycle-based one. Both runs must produce the same results.
+*/
+
+Logic clk(1,"clk");
+Logic sign(1,"sign");
+Logic dividend(32, "dividend");
+Logic divider(32, "divider");
+Logic quotient(32, "quotient");
+Logic quotient_temp(32, "quotient_temp");
+Logic remainder_r(32, "remainder");
+Logic ready(1,"ready");
+Logic start(1,"start");
+
+Logic divider_copy (64,"divider_copy") ;
+Logic dividend_copy (64,"dividend_copy") ;
+Logic negative_output(1,"negative_output");
+Logic bit(6,"bit");
+
+int comb1(Context *c)
+{
+    c->assign ( remainder_r,
+		(!negative_output.value()) ?
+                             dividend_copy.range(31,0) :
+                             ~dividend_copy.range(31,0) + Logic::from_int(1) );
+
+    c->assign (ready, !bit);
+    return 0;
+}
+
+int proc1(Context* c)
+{
+    if(start.value() && bit.value() == 0)
+    {
+	c->assign(bit, Logic::from_int(32));
+	c->assign(quotient, Logic::from_int(0));
+	c->assign(quotient_temp, Logic::from_int(0));
+
+	c->assign(dividend_copy, (!sign || !dividend.range(31)).value() ?
+		concat(LogicValue(32, 0), dividend) :
+		concat(LogicValue(32, 0), ~dividend + LogicValue(1, 1) ) );
+
+	c->assign(divider_copy, (!sign || !divider.range(31)).value() ?
+		concat(concat(LogicValue(1, 0), divider), LogicValue(31, 0) ) :
+		concat(concat(LogicValue(1, 0), ~divider + LogicValue(1, 1) ), LogicValue(31, 0) ));
+
+	c->assign(negative_output,
+		sign &&
+		((divider.range(31) && !dividend.range(31))
+		||(!divider.range(31) && dividend.range(31))));
+
+    } else if (bit.value() > 0) {
+
+	LogicValue diff = dividend_copy - divider_copy;
+	LogicValue qt = concat(quotient_temp.range(30,0), !diff.range(63));
+
+	if( (!diff.range(63)).value() )
+	    c->assign( dividend_copy, diff );
+
+	c->assign(quotient_temp, qt);
+	c->assign(quotient, (!negative_output).value() ? qt : ~qt + LogicValue(1, 1) );
+
+	c->assign(divider_copy, divider_copy >> 1);
+	c->assign(bit, bit - LogicValue(1, 1) );
+    }
+    return 0;
+}
+
+const int n_ops = 4;
+const int ops[n_ops][3] = { { 1000, 23, 0 }, { -1000, 23, 1 }, { 77777, -5, 1 }, { 123456, 789, 0 } };
+
+int state, op;
+std::vector<uint64_t> results;
+
+int proc_stimulus(Context *c)
+{
+    switch(state)
+    {
+	case 0:
+	    if(op == n_ops)
+		break;
+
+	    c->assign(dividend, Logic::from_int(ops[op][0]));
+	    c->assign(divider, Logic::from_int(ops[op][1]));
+	    c->assign(sign, Logic::from_int(ops[op][2]));
+	    c->assign(start, Logic::from_int(1));
+	    state = 1;
+	    break;
+
+	case 1:
+	    c->assign(start, Logic::from_int(0));
+	    state = 2;
+	    break;
+
+	case 2:
+	    if(!ready.value())
+		break;
+
+	    results.push_back(quotient.value());
+	    results.push_back(remainder_r.value());
+	    results.push_back(c->m_sim->m_time);
+	    op++;
+	    state = 0;
+	    break;
+    }
+    return 0;
+}
+
+std::vector<uint64_t> run( Simulation::EngineMode mode )
+{
+    Simulation sim;
+    std::set<SigBase*> sense_list;
+
+    LogicValue zero(1, 0);
+    Logic *sigs[] = { &clk, &sign, &dividend, &divider, &quotient, &quotient_temp, &remainder_r, &ready, &start,
+		      &divider_copy, &dividend_copy, &negative_output, &bit };
+
+    BOOST_FOREACH(Logic *s, sigs)
+    {
+	sim.add_signal(s);
+	s->initial(zero);
+	s->clear_changed();
+    }
+
+    state = op = 0;
+    results.clear();
+
+    sense_list.insert(&negative_output);
+    sense_list.insert(&dividend_copy);
+    sense_list.insert(&bit);
+
+    sim.add_clock(&clk, 10);
+    sim.add_comb_process(comb1, sense_list, "comb1");
+    sim.add_clocked_process(proc1, &clk, "proc1");
+    sim.add_clocked_process(proc_stimulus, &clk, "proc_stimulus");
+
+    sim.run(4000, mode);
+
+    return results;
+}
+
+int main()
+{
+    printf("Running simulation...\n");
+
+    std::vector<uint64_t> event_driven = run( Simulation::EVENT_DRIVEN );
+    std::vector<uint64_t> cycle_based = run( Simulation::CYCLE_BASED );
+
+    if( event_driven.size() != 3 * n_ops || cycle_based.size() != 3 * n_ops )
+    {
+	printf("not all divisions completed\n");
+	return 1;
+    }
+
+    for(int i = 0; i < n_ops; i++)
+    {
+	int a = ops[i][0], b = ops[i][1];
+	bool neg = ops[i][2] && ((a < 0) != (b < 0));
+	uint32_t ua = (ops[i][2] && a < 0) ? -a : a, ub = (ops[i][2] && b < 0) ? -b : b;
+
+	// like the RTL, the remainder takes the sign of the quotient
+	int q = neg ? -(int) (ua / ub) : ua / ub;
+	int r = neg ? -(int) (ua % ub) : ua % ub;
+
+	printf("%d / %d = %d, %d %% %d = %d at %d (cycle-based: %d, %d at %d, should be %d, %d)\n",
+	       a, b, (int) event_driven[3*i], a, b, (int) event_driven[3*i+1], (int) event_driven[3*i+2],
+	       (int) cycle_based[3*i], (int) cycle_based[3*i+1], (int) cycle_based[3*i+2], q, r);
+
+	if( event_driven[3*i] != (uint32_t) q || event_driven[3*i+1] != (uint32_t) r )
+	    return 1;
+    }
+
+    return event_driven == cycle_based ? 0 : 1;
+}
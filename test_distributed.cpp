@@ -0,0 +1,209 @@
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "sim.h"
+#include "partition.h"
+
+/*
+ Same two clock domains as test_partition, but each partition runs in its own
+ OS process and the slow domain echoes its samples back to the fast one.
+ Pass "socket" as the argument to use local sockets instead of shared memory.
+ A partition whose socket peer dies early must fail rather than wait forever,
+ and a shared memory channel opened with the wrong size must be refused.
+*/
+
+Logic clk_a(1,"clk_a");
+Logic counter_a(16,"counter_a");
+Logic echo(16,"echo");
+
+Logic clk_b(1,"clk_b");
+Logic counter_b(16,"counter_b");
+Logic sampled(16,"sampled");
+
+int proc_clk_a(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk_a, ~clk_a );
+	c->wait(5);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk_a);
+	c->assign(counter_a, counter_a + Logic::from_int(1));
+    }
+    return 0;
+}
+
+int proc_clk_b(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk_b, ~clk_b );
+	c->wait(15);
+    }
+    return 0;
+}
+
+int proc_sampler(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk_b);
+	c->assign(sampled, counter_b);
+    }
+    return 0;
+}
+
+int run_fast( SyncChannel *tx, SyncChannel *rx )
+{
+    Partition fast("fast", 10);
+
+    fast.m_sim.add_signal(&clk_a);
+    fast.m_sim.add_process(proc_clk_a, "clock_a", false);
+    fast.m_sim.add_process(proc_counter, "counter", false);
+    fast.add_output(&counter_a, tx, 0);
+    fast.add_input(&echo, rx, 0);
+
+    fast.run(1000);
+
+    // the last sample (taken at 960) that can make it back before 1000
+    printf("echo = %d (should be 96)\n", (int) echo.value());
+    return echo.value() == 96 ? 0 : 1;
+}
+
+int run_slow( SyncChannel *tx, SyncChannel *rx )
+{
+    Partition slow("slow", 30);
+
+    slow.m_sim.add_signal(&clk_b);
+    slow.m_sim.add_process(proc_clk_b, "clock_b", false);
+    slow.m_sim.add_process(proc_sampler, "sampler", false);
+    slow.add_input(&counter_b, rx, 0);
+    slow.add_output(&sampled, tx, 0);
+
+    slow.run(1000);
+
+    printf("sampled = %d (should be 99)\n", (int) sampled.value());
+    return sampled.value() == 99 ? 0 : 1;
+}
+
+// a partition whose input peer dies before the end fails instead of waiting
+bool dead_peer_detected()
+{
+    SocketChannel *tx, *rx;
+    Logic in(16, "in");
+    Partition p("orphan", 10);
+    bool failed = false;
+
+    SocketChannel::create_pair(&tx, &rx);
+    delete tx;
+
+    p.add_input(&in, rx, 0);
+
+    try
+    {
+	p.run(1000);
+    } catch( std::runtime_error& e ) {
+	printf("dead peer: %s\n", e.what());
+	failed = true;
+    }
+
+    delete rx;
+    return failed;
+}
+
+// opening a channel with another size than its creator's is refused
+bool size_mismatch_detected()
+{
+    char name[64];
+    bool refused = false;
+
+    sprintf(name, "/test_distributed_size_%d", getpid());
+    ShmChannel created(name, true, 12);
+
+    try
+    {
+	ShmChannel opened(name, false, 11);
+    } catch( std::runtime_error& e ) {
+	printf("size mismatch: %s\n", e.what());
+	refused = true;
+    }
+
+    // the right size is fine
+    ShmChannel opened(name, false, 12);
+    return refused;
+}
+
+int main(int argc, char *argv[])
+{
+    SyncChannel *fast_tx, *fast_rx, *slow_tx, *slow_rx;
+    bool sockets = argc > 1 && std::string(argv[1]) == "socket";
+
+    clk_a.initial( Logic::from_int(0) );
+    clk_b.initial( Logic::from_int(0) );
+    counter_a.initial( Logic::from_int(0) );
+    counter_b.initial( Logic::from_int(0) );
+    sampled.initial( Logic::from_int(0) );
+    echo.initial( Logic::from_int(0) );
+
+    if(!dead_peer_detected() || !size_mismatch_detected())
+	return 1;
+
+    if(sockets)
+    {
+	SocketChannel *a_tx, *a_rx, *b_tx, *b_rx;
+	SocketChannel::create_pair(&a_tx, &b_rx);
+	SocketChannel::create_pair(&b_tx, &a_rx);
+	fast_tx = a_tx; fast_rx = a_rx;
+	slow_tx = b_tx; slow_rx = b_rx;
+    } else {
+	char name[64];
+	sprintf(name, "/test_distributed_ab_%d", getpid());
+	fast_tx = slow_rx = new ShmChannel(name, true);
+	sprintf(name, "/test_distributed_ba_%d", getpid());
+	slow_tx = fast_rx = new ShmChannel(name, true);
+    }
+
+    printf("Running simulation (%s)...\n", sockets ? "sockets" : "shared memory");
+    fflush(stdout);
+
+    pid_t pid = fork();
+
+    // each process closes the other one's socket ends, so that either
+    // sees the connection drop if the other dies
+    if(pid == 0)
+    {
+	if(sockets)
+	{
+	    delete fast_tx;
+	    delete fast_rx;
+	}
+
+	return run_slow(slow_tx, slow_rx);
+    }
+
+    if(sockets)
+    {
+	delete slow_tx;
+	delete slow_rx;
+    }
+
+    int rv = run_fast(fast_tx, fast_rx);
+    int status;
+
+    waitpid(pid, &status, 0);
+
+    if(!sockets)
+    {
+	delete fast_tx;
+	delete fast_rx;
+    }
+
+    return (rv == 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
@@ -131,13 +131,13 @@ int proc1(Context* c)
 	        c->assign(quotient, Logic::from_int(0));
 
     		c->assign(dividend_copy, (!sign || !dividend.range(31)).value() ? 
-            		        concat(Logic(32).set_value(0), dividend) : 
-                    		concat(Logic(32).set_value(0), ~dividend + Logic(1).set_value(1) ) );
+            		        concat(LogicValue(32, 0), dividend) : 
+                    		concat(LogicValue(32, 0), ~dividend + LogicValue(1, 1) ) );
 
 
     		c->assign(divider_copy, (!sign || !divider.range(31)).value() ? 
-            		        concat(concat(Logic(1).set_value(0), divider), Logic(31).set_value(0) ) : 
-                    		concat(concat(Logic(1).set_value(0), ~divider + Logic(1).set_value(1) ), Logic(31).set_value(0) ));
+            		        concat(concat(LogicValue(1, 0), divider), LogicValue(31, 0) ) : 
+                    		concat(concat(LogicValue(1, 0), ~divider + LogicValue(1, 1) ), LogicValue(31, 0) ));
 
 		c->assign(negative_output, 
 
@@ -159,19 +159,19 @@ int proc1(Context* c)
     		if( (!diff.range(63)).value() ) 
 		{
  		   c->assign( dividend_copy, diff );
-            	  quotient_temp = concat(quotient.range(30,0), Logic(1).set_value(1) );
+            	  quotient_temp = concat(quotient.range(30,0), LogicValue(1, 1) );
 		} else {
 
-        	  quotient_temp = concat(quotient.range(30,0), Logic(1).set_value(0) );
+        	  quotient_temp = concat(quotient.range(30,0), LogicValue(1, 0) );
 
 		}
 
 	        c->assign(quotient, (!negative_output).value() ? 
                    quotient_temp : 
-                   ~quotient_temp + Logic(1).set_value(1) );
+                   ~quotient_temp + LogicValue(1, 1) );
 
 	        c->assign(divider_copy, divider_copy >> 1);
-	        c->assign(bit, bit -  Logic(1).set_value(1) );
+	        c->assign(bit, bit -  LogicValue(1, 1) );
 	    }
 	    
 	}
@@ -214,6 +214,7 @@ int proc_stimulus(Context *c)
 
 
     c->finish();
+    return 0;
 }
 
 
@@ -0,0 +1,210 @@
+#include "sim.h"
+#include "partition.h"
+
+/*
+ Events: a request/done handshake between two processes, first with
+ Events, then with the dummy Logic toggles it replaces (for the event and
+ delta counts), the timing rules of immediate, delta and timed
+ notifications, events destroyed while notified, and timed notifications
+ inside a partition, whose engine steps the kernel itself.
+*/
+
+const int n_transactions = 100000;
+
+Event request("request"), done("done");
+Logic request_sig(1, "request_sig"), done_sig(1, "done_sig");
+
+int n_served, n_errors;
+
+int proc_master(Context *c)
+{
+    for(int i = 0; i < n_transactions; i++)
+    {
+	c->notify(request, 1);
+	c->wait(done);
+    }
+
+    c->finish();
+    return 0;
+}
+
+int proc_slave(Context *c)
+{
+    for(;;)
+    {
+	c->wait(request);
+	n_served++;
+	c->notify(done);
+    }
+}
+
+int proc_master_sig(Context *c)
+{
+    for(int i = 0; i < n_transactions; i++)
+    {
+	c->wait(1);
+	c->assign(request_sig, ~request_sig);
+	c->wait_signal(done_sig);
+    }
+
+    c->finish();
+    return 0;
+}
+
+int proc_slave_sig(Context *c)
+{
+    for(;;)
+    {
+	c->wait_signal(request_sig);
+	n_served++;
+	c->assign(done_sig, ~done_sig);
+    }
+}
+
+// (time, delta) at which a waiter woke
+Event ev("ev"), never("never");
+std::vector< std::pair<int64_t, int> > woken;
+
+int proc_waiter(Context *c)
+{
+    for(;;)
+    {
+	c->wait(ev);
+	woken.push_back( std::make_pair( c->m_sim->m_time, c->m_sim->m_delta ) );
+    }
+}
+
+int proc_never(Context *c)
+{
+    c->wait(never);
+    n_errors++;
+    return 0;
+}
+
+int proc_notifier(Context *c)
+{
+    // immediate: the waiter (added first, so earlier in the process order)
+    // runs in the next delta, as with wake()
+    c->notify(ev);
+    c->wait(10);
+
+    // delta: next delta
+    c->notify(ev, 0);
+    c->wait(10);
+
+    // timed, the earlier of two wins and fires once
+    c->notify(ev, 30);
+    c->notify(ev, 5);
+    c->notify(ev, 7);
+
+    // cancelled
+    c->notify(never, 3);
+    c->m_sim->cancel(never);
+    c->wait(100);
+
+    c->finish();
+    return 0;
+}
+
+// notified events going out of scope take their notifications with them
+int proc_scoped(Context *c)
+{
+    {
+	Event timed("timed"), delta("delta");
+
+	c->notify(timed, 5);
+	c->notify(delta, 0);
+    }
+
+    c->wait(50);
+    c->finish();
+    return 0;
+}
+
+Event tick("tick");
+std::vector<int64_t> ticks;
+
+int proc_ticker(Context *c)
+{
+    for(int i = 0; i < 4; i++)
+    {
+	c->notify(tick, 5);
+	c->wait(tick);
+	ticks.push_back( c->m_sim->m_time );
+    }
+
+    c->finish();
+    return 0;
+}
+
+void partitioned()
+{
+    PartitionedSimulation ps;
+    Partition *p = ps.add_partition("ticker", 10);
+
+    p->m_sim.add_process(proc_ticker, "ticker", false);
+    ps.run(30);
+
+    printf("partition: woken at");
+    BOOST_FOREACH(int64_t t, ticks)
+	printf(" %lld", (long long) t);
+    printf("\n");
+
+    if(ticks.size() != 4 || ticks[0] != 5 || ticks[3] != 20)
+	n_errors++;
+}
+
+void handshake( bool events )
+{
+    Simulation sim;
+
+    n_served = 0;
+    sim.add_signal(&request_sig);
+    sim.add_signal(&done_sig);
+    request_sig.initial(LogicValue(1, 0));
+    done_sig.initial(LogicValue(1, 0));
+
+    sim.add_process(events ? proc_master : proc_master_sig, "master", false);
+    sim.add_process(events ? proc_slave : proc_slave_sig, "slave", false);
+    sim.run(n_transactions + 10);
+
+    printf("%s: %d transactions, %llu signal changes, %llu deltas\n", events ? "events" : "signals", n_served,
+	   (unsigned long long) sim.m_events, (unsigned long long) sim.m_deltas);
+
+    if(n_served != n_transactions || (events && sim.m_events))
+	n_errors++;
+}
+
+int main()
+{
+    printf("Running simulation...\n");
+
+    handshake(true);
+    handshake(false);
+
+    Simulation sim;
+
+    sim.add_process(proc_waiter, "waiter", false);
+    sim.add_process(proc_never, "never", false);
+    sim.add_process(proc_notifier, "notifier", false);
+    sim.add_process(proc_scoped, "scoped", false);
+    sim.run(200);
+
+    std::pair<int64_t, int> expected[] = { std::make_pair(0, 2), std::make_pair(10, 2), std::make_pair(25, 1) };
+
+    for(int i = 0; i < woken.size(); i++)
+	printf("woken at %lld, delta %d\n", (long long) woken[i].first, woken[i].second);
+
+    if(woken.size() != 3)
+	n_errors++;
+    else
+	for(int i = 0; i < 3; i++)
+	    if(woken[i] != expected[i])
+		n_errors++;
+
+    partitioned();
+
+    printf("%d errors\n", n_errors);
+
+    return n_errors ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+#include <new>
+#include <cstdlib>
+
+#include "sim.h"
+
+/*
+ Signal footprint: unnamed signals allocate nothing when created, names
+ resolve through the table, and a running design settles into steady state
+ without heap allocations per assignment.
+*/
+
+static long n_allocs;
+
+void *operator new( size_t size )
+{
+    n_allocs++;
+    if(void *p = malloc(size))
+	return p;
+    throw std::bad_alloc();
+}
+
+void operator delete( void *p ) noexcept
+{
+    free(p);
+}
+
+void operator delete( void *p, size_t ) noexcept
+{
+    free(p);
+}
+
+Logic clk(1,"clk");
+Logic counter(32,"counter");
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk);
+	c->assign(counter, counter + LogicValue(32, 1));
+    }
+}
+
+int main()
+{
+    const int n_signals = 1000000;
+    int n_errors = 0;
+
+    // raw storage, so that only the signal constructors can allocate
+    void *buf = malloc( n_signals * sizeof(Logic) );
+    Logic *sigs = (Logic *) buf;
+
+    long before = n_allocs;
+    for(int i = 0; i < n_signals; i++)
+	new (&sigs[i]) Logic(16);
+    long creation_allocs = n_allocs - before;
+
+    for(int i = 0; i < n_signals; i++)
+	sigs[i].~Logic();
+    free(buf);
+
+    if(clk.name() != "clk" || counter.name() != "counter" || Logic(4).name() != "?")
+	n_errors++;
+
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&counter);
+
+    clk.initial(LogicValue(1, 0));
+    counter.initial(LogicValue(32, 0));
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_counter, "counter", false);
+
+    printf("Running simulation...\n");
+
+    // warm up the kernel's vectors and heaps
+    sim.run(10000);
+
+    before = n_allocs;
+    sim.run(1000000);
+    long run_allocs = n_allocs - before;
+
+    if(counter.value() != 1000000 / 20)
+	n_errors++;
+
+    printf("sizeof(Logic) %d, %ld allocations creating %d signals, %ld allocations in %d cycles, %d errors\n",
+	   (int) sizeof(Logic), creation_allocs, n_signals, run_allocs, 1000000 / 20, n_errors);
+
+    return (!n_errors && !creation_allocs && !run_allocs && sizeof(Logic) <= 48) ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include "sim.h"
+#include "vcd.h"
+#include "wavecmp.h"
+
+/*
+ A counter dumped as a golden VCD, then rerun against it: once unchanged,
+ which must pass, and once with a bug injected at a known cycle, which must
+ stop at the first wrong value. The dumps of the two runs also go through
+ compare_vcd().
+*/
+
+Logic clk(1,"clk");
+Logic counter(16,"counter");
+Logic carry(1,"carry");
+
+const int n_cycles = 2000;
+const int bug_cycle = 1234;
+
+bool inject_bug;
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    for(int i = 0; ; i++)
+    {
+	c->wait_posedge(clk);
+
+	LogicValue next = counter + LogicValue(16, (inject_bug && i == bug_cycle) ? 2 : 1);
+	c->assign(counter, next);
+	c->assign(carry, LogicValue(1, next.value() == 0 ? 1 : 0));
+    }
+}
+
+// returns the time the run ended at
+static int64_t run( const char *dump, const char *golden, WaveMismatch *mismatch )
+{
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&counter);
+    sim.add_signal(&carry);
+
+    clk.initial(LogicValue(1, 0));
+    counter.initial(LogicValue(16, 0xfff0));
+    carry.initial(LogicValue(1, 0));
+
+    VCDWriter writer(dump, &sim);
+    WaveCompare *cmp = golden ? new WaveCompare(&sim, golden) : NULL;
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_counter, "counter", false);
+
+    sim.run(n_cycles * 20);
+    fflush(writer.m_file);
+
+    if(cmp)
+    {
+	if(mismatch)
+	    *mismatch = cmp->m_mismatch;
+	if(!cmp->ok() || !cmp->m_unmatched.empty() || cmp->failed() != (mismatch != NULL))
+	    sim.m_time = -1;
+	delete cmp;
+    }
+
+    return sim.m_time;
+}
+
+int main()
+{
+    int n_errors = 0;
+    WaveMismatch m;
+    std::string error;
+
+    printf("Running simulation...\n");
+
+    inject_bug = false;
+    run("test_golden.vcd", NULL, NULL);
+
+    if( run("test_golden_pass.vcd", "test_golden.vcd", NULL) != n_cycles * 20 )
+    {
+	printf("clean run did not match the golden\n");
+	n_errors++;
+    }
+
+    inject_bug = true;
+    int64_t stopped = run("test_golden_fail.vcd", "test_golden.vcd", &m);
+
+    // the edge of cycle i is at 20 * i, its value is dumped one step later
+    int64_t bug_time = bug_cycle * 20 + 10;
+
+    printf("stopped at %lld: %s\n", (long long) stopped, m.describe().c_str());
+
+    if( stopped != bug_time || m.m_name != "counter" || m.m_time != bug_time ||
+	m.m_expected != ((0xfff0 + bug_cycle + 1) & 0xffff) || m.m_actual != ((0xfff0 + bug_cycle + 2) & 0xffff) )
+	n_errors++;
+
+    if( !compare_vcd("test_golden.vcd", "test_golden_pass.vcd", m, error) )
+    {
+	printf("compare_vcd: %s\n", error.c_str());
+	n_errors++;
+    }
+
+    if( compare_vcd("test_golden.vcd", "test_golden_fail.vcd", m, error) || m.m_name != "counter" || m.m_time != bug_time )
+    {
+	printf("compare_vcd missed the difference\n");
+	n_errors++;
+    }
+
+    printf("%d errors\n", n_errors);
+
+    return n_errors ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+#include "sim.h"
+#include "history.h"
+
+/*
+ A free-running counter with its history recorded twice: completely and
+ with a short retention window. A checker process compares $past-style
+ lookups with the counter, and the full history is queried after the run,
+ along with the words of a small memory the counter is written to.
+*/
+
+Logic clk(1,"clk");
+Logic counter(32,"counter");
+Memory regs(32, 8, "regs");
+
+const int64_t half_period = 10, period = 2 * half_period;
+const int n_cycles = 50000;
+
+History *full, *recent;
+int n_errors;
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(half_period);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk);
+	c->assign(counter, counter + LogicValue(32, 1));
+	regs.write(c, counter.value() % 8, counter);
+    }
+}
+
+int proc_check(Context *c)
+{
+    for(int i = 0; ; i++)
+    {
+	c->wait_posedge(clk);
+
+	// counter.value() is what the counter sampled at this edge
+	if( i >= 3 && ( full->past(counter, 3, period).value() != counter.value() - 3 ||
+			recent->past(counter, 3, period).value() != counter.value() - 3 ) )
+	    n_errors++;
+    }
+}
+
+int main()
+{
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&counter);
+    sim.add_signal(&regs);
+
+    clk.initial(LogicValue(1, 0));
+    counter.initial(LogicValue(32, 0));
+
+    full = new History(&sim);
+    recent = new History(&sim, 1000);
+
+    full->track_all();
+    recent->track(&counter);
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_counter, "counter", false);
+    sim.add_process(proc_check, "check", false);
+
+    printf("Running simulation...\n");
+
+    sim.run(n_cycles * period);
+
+    // the counter increments at every rising edge: 0, 20, 40...
+    for(int64_t t = 0; t < n_cycles * period; t += 7777)
+    {
+	uint64_t expected = t / period + 1;
+
+	if( full->at(counter, t).value() != expected || full->value_before(&counter, t) != (t % period ? expected : expected - 1) )
+	{
+	    printf("counter at %lld: %llu (should be %llu)\n", (long long) t,
+		   (unsigned long long) full->at(counter, t).value(), (unsigned long long) expected);
+	    n_errors++;
+	}
+
+	// edge n (at n * period) writes n to word n % 8
+	int64_t n = t / period;
+	uint64_t addr = t % 8;
+	uint64_t word = n < addr ? 0 : n - (n - addr) % 8;
+
+	if( full->word_at(&regs, addr, t) != word )
+	{
+	    printf("regs[%llu] at %lld: %llu (should be %llu)\n", (unsigned long long) addr, (long long) t,
+		   (unsigned long long) full->word_at(&regs, addr, t), (unsigned long long) word);
+	    n_errors++;
+	}
+    }
+
+    printf("full history: %d kB, with retention: %d kB, %d errors\n",
+	   (int) (full->memory_used() / 1024), (int) (recent->memory_used() / 1024), n_errors);
+
+    bool ok = !n_errors && recent->memory_used() < full->memory_used() / 10;
+
+    delete full;
+    delete recent;
+
+    return ok ? 0 : 1;
+}
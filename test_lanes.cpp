@@ -0,0 +1,125 @@
+#include "sim.h"
+#include "lanes.h"
+
+/*
+ The unsigned path of the divider from test_divide.cpp, evaluated for
+ n_lanes operand pairs at once. Control (start, bit) is shared by all
+ lanes, the datapath is lane-parallel.
+*/
+
+const int n_lanes = 8;
+typedef Lanes<n_lanes> L;
+
+Logic clk(1,"clk");
+Logic start(1,"start");
+Logic bit(6,"bit");
+
+LogicLanes<n_lanes> dividend(32, "dividend");
+LogicLanes<n_lanes> divider(32, "divider");
+LogicLanes<n_lanes> quotient(32, "quotient");
+LogicLanes<n_lanes> dividend_copy(64, "dividend_copy");
+LogicLanes<n_lanes> divider_copy(64, "divider_copy");
+
+int proc1(Context* c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk);
+
+	if(start.value() && bit.value() == 0)
+	{
+	    c->assign(bit, Logic::from_int(32));
+	    c->assign(quotient, L(32));
+	    c->assign(dividend_copy, concat( L(32), dividend.value() ));
+	    c->assign(divider_copy, concat( concat( L(1), divider.value() ), L(31) ));
+	} else if (bit.value() > 0) {
+	    L diff = dividend_copy - divider_copy;
+	    L no_borrow = !diff.range(63);
+
+	    // lanes diverge on the sign of the difference
+	    c->assign(dividend_copy, select( no_borrow, diff, dividend_copy.value() ));
+	    c->assign(quotient, concat( quotient.range(30, 0), no_borrow ));
+	    c->assign(divider_copy, divider_copy >> 1);
+	    c->assign(bit, bit - LogicValue(1, 1));
+	}
+    }
+}
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+uint32_t a[n_lanes], b[n_lanes];
+int n_errors = 0;
+
+int proc_stimulus(Context *c)
+{
+    L va(32), vb(32);
+
+    for(int i = 0; i < n_lanes; i++)
+    {
+	a[i] = 1000 + i * 123457;
+	b[i] = 23 + i * 7;
+	va.set_lane(i, a[i]);
+	vb.set_lane(i, b[i]);
+    }
+
+    for(int i = 0; i < 3;i++)
+	c->wait_posedge(clk);
+
+    c->assign(dividend, va);
+    c->assign(divider, vb);
+    c->assign(start, Logic::from_int(1));
+
+    c->wait_posedge(clk);
+    c->assign(start, Logic::from_int(0));
+    c->wait_posedge(clk);
+
+    while( bit.value() )
+	c->wait_posedge(clk);
+
+    for(int i = 0; i < n_lanes; i++)
+    {
+	uint32_t q = quotient.lane(i), r = dividend_copy.lane(i);
+
+	printf("lane %d: %u / %u = %u rem %u (should be %u rem %u)\n", i, a[i], b[i], q, r, a[i] / b[i], a[i] % b[i]);
+	if(q != a[i] / b[i] || r != a[i] % b[i])
+	    n_errors++;
+    }
+
+    c->finish();
+    return 0;
+}
+
+int main()
+{
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&start);
+    sim.add_signal(&bit);
+    sim.add_signal(&dividend);
+    sim.add_signal(&divider);
+    sim.add_signal(&quotient);
+    sim.add_signal(&dividend_copy);
+    sim.add_signal(&divider_copy);
+
+    clk.initial(Logic::from_int(0));
+    bit.initial(Logic::from_int(0));
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc1, "proc1", false);
+    sim.add_process(proc_stimulus, "proc_stimulus", false);
+
+    printf("Running simulation...\n");
+
+    sim.run(2000);
+
+    return n_errors ? 1 : 0;
+}
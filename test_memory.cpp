@@ -0,0 +1,97 @@
+#include "sim.h"
+#include "vcd.h"
+#include "memory.h"
+
+/*
+ A 1M-word RAM preloaded through the backdoor, and a small register file
+ dumped to VCD. A writer process copies RAM words into the register file,
+ a watcher waits for one particular register.
+*/
+
+const uint64_t n_words = 1 << 20;
+
+Logic clk(1,"clk");
+Memory ram(32, n_words, "ram");
+Memory regs(16, 16, "regs");
+
+int n_errors, watched_value;
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+// regs[i] = ram[i * 4096] for every i, one per clock
+int proc_copy(Context *c)
+{
+    for(int i = 0; i < regs.size(); i++)
+    {
+	c->wait_posedge(clk);
+	regs.write( c, i, ram[i * 4096] );
+    }
+
+    c->wait_posedge(clk);
+
+    for(int i = 0; i < regs.size(); i++)
+	if( regs[i].value() != ((i * 4096 * 3) & 0xffff) )
+	    n_errors++;
+
+    c->finish();
+    return 0;
+}
+
+int proc_watch(Context *c)
+{
+    regs.wait_word(c, 5);
+    watched_value = regs[5].value();
+
+    c->finish();
+    return 0;
+}
+
+int main()
+{
+    Simulation sim;
+    const char *image = "test_memory.bin";
+
+    // backdoor image: word i = i * 3
+    FILE *f = fopen(image, "wb");
+    for(uint64_t i = 0; i < n_words; i++)
+    {
+	uint64_t v = (i * 3) & 0xffffffff;
+	fwrite(&v, sizeof(v), 1, f);
+    }
+    fclose(f);
+
+    if( !ram.load(image) )
+    {
+	printf("can't load %s\n", image);
+	return 1;
+    }
+
+    sim.add_signal(&clk);
+    sim.add_signal(&ram);
+    sim.add_signal(&regs);
+
+    clk.initial(LogicValue(1, 0));
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_copy, "copy", false);
+    sim.add_process(proc_watch, "watch", false);
+
+    VCDWriter writer("test_memory.vcd", &sim);
+
+    printf("Running simulation...\n");
+
+    sim.run(400);
+
+    printf("ram[12345] = %d (should be %d)\n", (int) ram[12345].value(), 12345 * 3);
+    printf("regs[5] = %d when first written (should be %d), %d errors\n", watched_value, (5 * 4096 * 3) & 0xffff, n_errors);
+
+    return ( ram[12345].value() == 12345 * 3 && watched_value == ((5 * 4096 * 3) & 0xffff) && !n_errors ) ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#include "netlist.h"
+
+/*
+ Gate-level netlists: a 4-bit ripple carry adder checked exhaustively, 64
+ input combinations per evaluation, and an 8-bit counter with enable built
+ from DFFs and half adders, running in the simulation next to the same
+ counter written behaviourally.
+*/
+
+Logic clk(1,"clk");
+Logic enable(1,"enable");
+Logic count_rtl(8,"count_rtl");
+Logic count_gates(8,"count_gates");
+
+int n_errors, n_checks;
+
+// returns (sum, carry out)
+std::pair<int, int> full_adder( Netlist& n, int a, int b, int c )
+{
+    int axb = n.add_gate( Netlist::XOR, a, b );
+    int sum = n.add_gate( Netlist::XOR, axb, c );
+    // a and b equal: the carry is either, otherwise it propagates c
+    int carry = n.add_gate( Netlist::MUX, a, c, axb );
+
+    return std::make_pair(sum, carry);
+}
+
+bool test_adder()
+{
+    Netlist n;
+    int a[4], b[4], sum[4], cin, carry;
+
+    for(int i = 0; i < 4; i++)
+    {
+	a[i] = n.add_input();
+	b[i] = n.add_input();
+    }
+    cin = carry = n.add_input();
+
+    for(int i = 0; i < 4; i++)
+    {
+	std::pair<int, int> fa = full_adder( n, a[i], b[i], carry );
+	sum[i] = fa.first;
+	carry = fa.second;
+    }
+
+    if(!n.build())
+	return false;
+
+    printf("adder: %d gates, %d levels\n", n.n_gates(), n.n_levels());
+
+    // 9 inputs: 512 combinations, 8 passes of 64 patterns
+    int errors = 0;
+
+    for(int pass = 0; pass < 8; pass++)
+    {
+	uint64_t in[9] = { 0 };
+
+	for(int k = 0; k < 64; k++)
+	{
+	    int combo = pass * 64 + k;
+	    for(int i = 0; i < 9; i++)
+		in[i] |= (uint64_t) ((combo >> i) & 1) << k;
+	}
+
+	for(int i = 0; i < 4; i++)
+	{
+	    n.net(a[i]) = in[i];
+	    n.net(b[i]) = in[4 + i];
+	}
+	n.net(cin) = in[8];
+
+	n.eval();
+
+	for(int k = 0; k < 64; k++)
+	{
+	    int combo = pass * 64 + k;
+	    int expected = (combo & 15) + ((combo >> 4) & 15) + (combo >> 8);
+	    int got = (n.net(carry) >> k & 1) << 4;
+
+	    for(int i = 0; i < 4; i++)
+		got |= (n.net(sum[i]) >> k & 1) << i;
+
+	    if(got != expected)
+		errors++;
+	}
+    }
+
+    printf("adder: %d errors\n", errors);
+    return errors == 0;
+}
+
+bool test_loop()
+{
+    Netlist n;
+    int a = n.add_input(), x = n.add_net();
+
+    // x = a ^ (x & a): combinational feedback without a DFF
+    int y = n.add_gate( Netlist::AND, x, a );
+    n.add_gate( Netlist::XOR, a, y, -1, x );
+
+    return !n.build();
+}
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk);
+	if(enable.value())
+	    c->assign(count_rtl, count_rtl + LogicValue(8, 1));
+    }
+}
+
+int proc_stimulus(Context *c)
+{
+    uint32_t lfsr = 0xace1;
+
+    for(;;)
+    {
+	c->wait_posedge(clk);
+	c->wait(5);
+
+	lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xb400);
+	c->assign(enable, LogicValue(1, (lfsr & 3) != 0));
+
+	if(count_rtl.value() != count_gates.value())
+	    n_errors++;
+	n_checks++;
+    }
+}
+
+int main()
+{
+    bool ok = test_adder();
+
+    if(!test_loop())
+    {
+	printf("loop not detected\n");
+	ok = false;
+    }
+
+    Simulation sim;
+    Netlist counter;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&enable);
+    sim.add_signal(&count_rtl);
+    sim.add_signal(&count_gates);
+
+    clk.initial(LogicValue(1, 0));
+    enable.initial(LogicValue(1, 1));
+    count_rtl.initial(LogicValue(8, 0));
+    count_gates.initial(LogicValue(8, 0));
+
+    // q + enable: a chain of half adders
+    int carry = counter.add_input(&enable, 0);
+
+    for(int i = 0; i < 8; i++)
+    {
+	int q = counter.add_dff();
+
+	counter.set_d( q, counter.add_gate( Netlist::XOR, q, carry ) );
+	carry = counter.add_gate( Netlist::AND, q, carry );
+	counter.add_output( q, &count_gates, i );
+    }
+
+    if(!counter.build())
+    {
+	printf("counter netlist does not build\n");
+	return 1;
+    }
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_counter, "counter", false);
+    sim.add_process(proc_stimulus, "stimulus", false);
+    counter.attach(&sim, &clk, "counter_gates");
+
+    printf("Running simulation...\n");
+
+    sim.run(20000);
+
+    printf("counter: %d checks, %d errors, final %d/%d\n", n_checks, n_errors,
+	   (int) count_rtl.value(), (int) count_gates.value());
+
+    return ok && !n_errors && n_checks > 900 ? 0 : 1;
+}
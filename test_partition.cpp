@@ -0,0 +1,92 @@
+#include "sim.h"
+#include "partition.h"
+
+/*
+ Two clock domains in two partitions (threads):
+ - "fast" runs clk_a (period 10) and a free-running counter,
+ - "slow" runs clk_b (period 30) and samples the counter on each of its edges.
+ The counter crosses to "slow" with a latency of one clk_a period.
+*/
+
+Logic clk_a(1,"clk_a");
+Logic counter_a(16,"counter_a");
+
+Logic clk_b(1,"clk_b");
+Logic counter_b(16,"counter_b");
+Logic sampled(16,"sampled");
+
+int proc_clk_a(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk_a, ~clk_a );
+	c->wait(5);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk_a);
+	c->assign(counter_a, counter_a + Logic::from_int(1));
+    }
+    return 0;
+}
+
+int proc_clk_b(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk_b, ~clk_b );
+	c->wait(15);
+    }
+    return 0;
+}
+
+int proc_sampler(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk_b);
+	c->assign(sampled, counter_b);
+    }
+    return 0;
+}
+
+int main()
+{
+    PartitionedSimulation psim;
+
+    Partition *fast = psim.add_partition("fast", 10);
+    Partition *slow = psim.add_partition("slow", 30);
+
+    fast->m_sim.add_signal(&clk_a);
+    fast->m_sim.add_process(proc_clk_a, "clock_a", false);
+    fast->m_sim.add_process(proc_counter, "counter", false);
+
+    slow->m_sim.add_signal(&clk_b);
+    slow->m_sim.add_signal(&sampled);
+    slow->m_sim.add_process(proc_clk_b, "clock_b", false);
+    slow->m_sim.add_process(proc_sampler, "sampler", false);
+
+    clk_a.initial( Logic::from_int(0) );
+    clk_b.initial( Logic::from_int(0) );
+    counter_a.initial( Logic::from_int(0) );
+    counter_b.initial( Logic::from_int(0) );
+    sampled.initial( Logic::from_int(0) );
+
+    psim.connect(fast, &counter_a, slow, &counter_b);
+
+    printf("Running simulation...\n");
+
+    psim.run(1000);
+
+    // last clk_b edge before 1000 is at 990, where counter_b shows the
+    // value counter_a had at 980 (99 edges of clk_a, at 0, 10, ... 980)
+    printf("counter_a = %d (should be 100)\n", (int) counter_a.value());
+    printf("sampled = %d (should be 99)\n", (int) sampled.value());
+
+    return (counter_a.value() == 100 && sampled.value() == 99) ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include "sim.h"
+#include "vcd.h"
+#include "replay.h"
+
+/*
+ A small accumulator block inside a design that is mostly something else:
+ a stimulus generator feeding the block and a crowd of unrelated busy
+ processes. The full run records the block's boundary; the block is then
+ replayed alone, once unchanged (no divergence, same final value) and once
+ with a bug at a known cycle (divergence reported there).
+*/
+
+const int n_cycles = 2000;
+const int n_filler = 64;
+const int bug_cycle = 777;
+
+bool inject_bug;
+
+struct Design
+{
+    Design() : clk(1, "clk"), in(8, "in"), acc(16, "acc")
+    {
+	sim.add_signal(&clk);
+	sim.add_signal(&in);
+	sim.add_signal(&acc);
+
+	clk.initial(LogicValue(1, 0));
+	in.initial(LogicValue(8, 0));
+	acc.initial(LogicValue(16, 0));
+    }
+
+    Simulation sim;
+    Logic clk, in, acc;
+};
+
+int proc_clk(Context *c)
+{
+    Design *d = (Design *) c->m_arg;
+
+    for(;;)
+    {
+	c->assign( d->clk, ~d->clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+// the block
+int proc_acc(Context *c)
+{
+    Design *d = (Design *) c->m_arg;
+
+    for(int i = 0; ; i++)
+    {
+	c->wait_posedge(d->clk);
+
+	LogicValue sum = d->acc + LogicValue(16, d->in.value());
+	if(inject_bug && i == bug_cycle)
+	    sum = sum ^ LogicValue(16, 0x100);
+	c->assign(d->acc, sum);
+    }
+}
+
+// the rest of the design
+int proc_stimulus(Context *c)
+{
+    Design *d = (Design *) c->m_arg;
+    uint32_t lfsr = 0xace1;
+
+    for(;;)
+    {
+	c->wait_posedge(d->clk);
+	lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xb400);
+	c->assign(d->in, LogicValue(8, lfsr & 0xff));
+    }
+}
+
+int proc_filler(Context *c)
+{
+    Logic *sig = (Logic *) c->m_arg;
+
+    for(int i = 0; ; i++)
+    {
+	c->wait(1 + i % 3);
+	c->assign(*sig, *sig + LogicValue(32, 1));
+    }
+}
+
+int main()
+{
+    int n_errors = 0;
+    uint64_t full_acc, full_events;
+
+    printf("Running simulation...\n");
+
+    {
+	Design d;
+	std::vector<Logic *> filler;
+
+	for(int i = 0; i < n_filler; i++)
+	{
+	    filler.push_back( new Logic(32, "filler") );
+	    d.sim.add_signal( filler.back() );
+	    d.sim.add_process( proc_filler, "filler", false, filler.back() );
+	}
+
+	std::set<SigBase *> boundary;
+	boundary.insert(&d.clk);
+	boundary.insert(&d.in);
+	boundary.insert(&d.acc);
+
+	VCDWriter writer("test_replay.vcd", &d.sim, boundary);
+
+	d.sim.add_process(proc_clk, "clock_gen", false, &d);
+	d.sim.add_process(proc_stimulus, "stimulus", false, &d);
+	d.sim.add_process(proc_acc, "acc", false, &d);
+
+	d.sim.run(n_cycles * 20);
+	fclose(writer.m_file);
+
+	full_acc = d.acc.value();
+	full_events = d.sim.m_events;
+
+	BOOST_FOREACH(Logic *l, filler)
+	    delete l;
+    }
+
+    for(int pass = 0; pass < 2; pass++)
+    {
+	Design d;
+	std::vector<Logic *> clocks, inputs;
+
+	inject_bug = pass == 1;
+
+	clocks.push_back(&d.clk);
+	inputs.push_back(&d.in);
+
+	Replay replay(&d.sim, "test_replay.vcd", clocks, inputs);
+
+	if(!replay.ok() || !replay.m_unmatched.empty())
+	{
+	    printf("replay: %s\n", replay.m_error.c_str());
+	    return 1;
+	}
+
+	d.sim.add_process(proc_acc, "acc", false, &d);
+	d.sim.run(n_cycles * 20);
+
+	printf("replay %d: %llu events (full run: %llu), acc %d (full run: %d), %s\n", pass,
+	       (unsigned long long) d.sim.m_events, (unsigned long long) full_events,
+	       (int) d.acc.value(), (int) full_acc,
+	       replay.diverged() ? replay.divergence().describe().c_str() : "no divergence");
+
+	if(pass == 0 && (replay.diverged() || d.acc.value() != full_acc || d.sim.m_events * 10 > full_events))
+	    n_errors++;
+
+	// the edge of cycle i is at 20 * i, its value is dumped one step
+	// later - the fillers made a step of every time unit of the recording
+	if(pass == 1 && (!replay.diverged() || replay.divergence().m_name != "acc" ||
+			 replay.divergence().m_time != bug_cycle * 20 + 1))
+	    n_errors++;
+    }
+
+    printf("%d errors\n", n_errors);
+
+    return n_errors ? 1 : 0;
+}
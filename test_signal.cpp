@@ -0,0 +1,130 @@
+#include "sim.h"
+#include "vcd.h"
+#include "typedsig.h"
+#include "vcdreader.h"
+
+/*
+ Behavioural producer/consumer over typed signals: a struct request, an
+ enum state and a double result. Rewriting a signal with its current value
+ must not wake anybody. The double is dumped as a VCD real and read back.
+*/
+
+enum State { ST_IDLE, ST_BUSY, ST_DONE };
+
+struct Request
+{
+    int32_t m_id;
+    float m_operand;
+};
+
+Logic clk(1,"clk");
+Signal<Request> request("request");
+Signal<State> state("state");
+Signal<double> result("result");
+
+const int n_requests = 1000;
+
+int n_requests_seen, n_results_seen, n_errors;
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_producer(Context *c)
+{
+    for(int i = 1; i <= n_requests; i++)
+    {
+	Request r = { i, (float) i * 0.5f };
+
+	c->wait_posedge(clk);
+	c->assign(request, r);
+	c->assign(state, ST_BUSY);
+	// same value twice in one delta: one commit
+	c->assign(state, ST_BUSY);
+    }
+
+    c->wait_posedge(clk);
+    c->assign(state, ST_DONE);
+    c->finish();
+    return 0;
+}
+
+int proc_consumer(Context *c)
+{
+    for(;;)
+    {
+	c->wait_signal(request);
+	n_requests_seen++;
+
+	const Request& r = request.value();
+
+	if(r.m_id != n_requests_seen)
+	    n_errors++;
+
+	c->assign(result, r.m_operand * 2.0);
+    }
+}
+
+int proc_monitor(Context *c)
+{
+    for(;;)
+    {
+	c->wait_signal(result);
+	n_results_seen++;
+
+	if(result != (double) n_results_seen)
+	    n_errors++;
+    }
+}
+
+int main()
+{
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&request);
+    sim.add_signal(&state);
+    sim.add_signal(&result);
+
+    clk.initial(LogicValue(1, 0));
+    state.initial(ST_IDLE);
+
+    result.trace(TypedSigBase::TRACE_REAL);
+    state.trace(TypedSigBase::TRACE_BITS);
+
+    VCDWriter *writer = new VCDWriter("test_signal.vcd", &sim);
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_producer, "producer", false);
+    sim.add_process(proc_consumer, "consumer", false);
+    sim.add_process(proc_monitor, "monitor", false);
+
+    printf("Running simulation...\n");
+
+    sim.run((n_requests + 2) * 20);
+    fclose(writer->m_file);
+
+    // the last result as dumped
+    VCDReader reader;
+    VCDReader::Change ch;
+    double last = 0;
+    int code = reader.open("test_signal.vcd") ? reader.find("result") : -1;
+
+    while(code >= 0 && reader.next(ch))
+	if(ch.m_code == code)
+	    memcpy(&last, &ch.m_value, sizeof(last));
+
+    printf("%d requests, %d results (should be %d), state %d, dumped result %g, %d errors\n",
+	   n_requests_seen, n_results_seen, n_requests, state.value(), last, n_errors);
+
+    bool ok = !n_errors && n_requests_seen == n_requests && n_results_seen == n_requests &&
+	state.value() == ST_DONE && last == n_requests;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+#include "sim.h"
+
+/*
+ A testbench that spawns a short-lived process per transaction: each
+ transaction forks a few workers with different latencies and joins them
+ all, every tenth one races two workers with join_any. Contexts are pooled,
+ so the scheduler must not grow past the peak number of live processes.
+*/
+
+Logic clk(1,"clk");
+Logic counter(32,"counter");
+
+const int n_transactions = 50000;
+const int n_workers = 4;
+
+int n_done, n_any, n_errors;
+int64_t work_sum;
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk);
+	c->assign(counter, counter + LogicValue(32, 1));
+    }
+}
+
+int worker(Context *c)
+{
+    intptr_t latency = (intptr_t) c->m_arg;
+
+    // wait a few clock edges, like a bus transfer
+    for(int i = 0; i < latency; i++)
+	c->wait_posedge(clk);
+
+    work_sum += latency;
+    return 0;
+}
+
+int transaction(Context *c)
+{
+    intptr_t id = (intptr_t) c->m_arg;
+    std::vector<Process> workers;
+
+    if(id % 10 == 0)
+    {
+	workers.push_back( c->spawn(worker, "slow", (void *) 5) );
+	workers.push_back( c->spawn(worker, "fast", (void *) 1) );
+
+	if( c->join_any(workers) != 1 )
+	    n_errors++;
+	n_any++;
+
+	c->join(workers[0]);
+    } else {
+	for(int i = 0; i < n_workers; i++)
+	    workers.push_back( c->spawn(worker, "worker", (void *) (intptr_t) (i + 1)) );
+
+	c->join_all(workers);
+
+	BOOST_FOREACH(const Process& p, workers)
+	    if(!p.done())
+		n_errors++;
+    }
+
+    n_done++;
+    return 0;
+}
+
+int proc_testbench(Context *c)
+{
+    std::vector<Process> pending;
+
+    for(int i = 0; i < n_transactions; i++)
+    {
+	// up to 8 transactions in flight
+	pending.push_back( c->spawn(transaction, "transaction", (void *) (intptr_t) i) );
+
+	if(pending.size() == 8)
+	{
+	    int first = c->join_any(pending);
+	    pending.erase(pending.begin() + first);
+	}
+
+	c->wait_posedge(clk);
+    }
+
+    c->join_all(pending);
+    c->finish();
+    return 0;
+}
+
+int main()
+{
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&counter);
+
+    clk.initial(LogicValue(1, 0));
+    counter.initial(LogicValue(32, 0));
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_counter, "counter", false);
+    sim.add_process(proc_testbench, "testbench", false);
+
+    printf("Running simulation...\n");
+
+    sim.run((int64_t) n_transactions * 20 + 1000);
+
+    int64_t expected_sum = (int64_t) (n_transactions / 10) * 6 + (int64_t) (n_transactions - n_transactions / 10) * 10;
+
+    printf("%d transactions (should be %d), %d join_any, work %lld (should be %lld), %d contexts, %d errors\n",
+	   n_done, n_transactions, n_any, (long long) work_sum, (long long) expected_sum, (int) sim.m_ctxs.size(), n_errors);
+
+    // 8 transactions with at most 4 workers each, plus the fixed processes
+    bool ok = !n_errors && n_done == n_transactions && work_sum == expected_sum && sim.m_ctxs.size() <= 3 + 8 * 5;
+
+    return ok ? 0 : 1;
+}
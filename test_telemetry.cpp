@@ -0,0 +1,111 @@
+#include <thread>
+
+#include "sim.h"
+#include "telemetry.h"
+
+/*
+ A counter run with telemetry published every millisecond, while a reader
+ thread keeps taking snapshots of the page and checks that they are
+ consistent: simulated time never goes back and the process counts always
+ add up.
+*/
+
+Logic clk(1,"clk");
+Logic counter(32,"counter");
+
+const int n_cycles = 400000;
+const char *c_statsFile = "test_telemetry.stats";
+
+std::atomic<bool> done(false);
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    for(;;)
+    {
+	c->wait_posedge(clk);
+	c->assign(counter, counter + LogicValue(32, 1));
+    }
+}
+
+int n_snapshots, n_errors;
+
+void reader( const TelemetryPage *page )
+{
+    int64_t last_time = 0;
+
+    while(!done)
+    {
+	TelemetryPage s;
+
+	if( !Telemetry::read(page, s) )
+	    continue;
+
+	int n = 0;
+	for(int i = 0; i < TelemetryPage::c_states; i++)
+	    n += s.m_processes[i];
+
+	if( s.m_simTime < last_time || (s.m_publishes && n != 2) )
+	    n_errors++;
+
+	last_time = s.m_simTime;
+	n_snapshots++;
+    }
+}
+
+int main()
+{
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&counter);
+
+    clk.initial(LogicValue(1, 0));
+    counter.initial(LogicValue(32, 0));
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_counter, "counter", false);
+
+    Telemetry *telemetry = new Telemetry(&sim, c_statsFile, 0.001);
+
+    if(!telemetry->ok())
+    {
+	printf("cannot create %s\n", c_statsFile);
+	return 1;
+    }
+
+    int fd = open( c_statsFile, O_RDONLY );
+    const TelemetryPage *page = (const TelemetryPage *) mmap( NULL, sizeof(TelemetryPage), PROT_READ, MAP_SHARED, fd, 0 );
+    close(fd);
+
+    std::thread t( reader, page );
+
+    printf("Running simulation...\n");
+
+    sim.run(n_cycles * 20);
+
+    delete telemetry;
+    done = true;
+    t.join();
+
+    TelemetryPage s;
+    Telemetry::read(page, s);
+
+    printf("time %lld, %llu steps, %llu events, %llu deltas, %llu publishes, %d snapshots, %d errors\n",
+	   (long long) s.m_simTime, (unsigned long long) s.m_steps, (unsigned long long) s.m_events,
+	   (unsigned long long) s.m_deltas, (unsigned long long) s.m_publishes, n_snapshots, n_errors);
+
+    bool ok = !n_errors && !s.m_running && s.m_simTime == sim.m_time && s.m_steps == sim.m_steps &&
+	s.m_events == sim.m_events && s.m_processes[Context::WAITING_TIME] + s.m_processes[Context::WAITING_EVENT] == 2;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#include <fstream>
+#include <thread>
+
+#include "timeline.h"
+
+/*
+ Two independent simulations on two threads record into one Timeline, with
+ a window of [100, 300). The trace must hold both threads' tracks, balanced
+ slices, and nothing from outside the window.
+*/
+
+struct Design
+{
+    Design() : clk(1, "clk"), counter(8, "counter") {}
+
+    Simulation sim;
+    Logic clk, counter;
+};
+
+int proc_clk(Context *c)
+{
+    Design *d = (Design *) c->m_arg;
+
+    for(;;)
+    {
+	c->assign( d->clk, ~d->clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_counter(Context *c)
+{
+    Design *d = (Design *) c->m_arg;
+
+    for(;;)
+    {
+	c->wait_posedge(d->clk);
+	c->assign(d->counter, d->counter + LogicValue(8, 1));
+    }
+}
+
+void run_design( Design *d, Timeline *t, const char *name )
+{
+    d->sim.add_signal(&d->clk);
+    d->sim.add_signal(&d->counter);
+    d->clk.initial(LogicValue(1, 0));
+    d->counter.initial(LogicValue(8, 0));
+
+    d->sim.add_process(proc_clk, "clock_gen", false, d);
+    d->sim.add_process(proc_counter, "counter", false, d);
+
+    t->name_thread(name);
+    t->attach(&d->sim);
+    d->sim.run(1000);
+}
+
+int main()
+{
+    const char *file = "test_timeline.json";
+    Design a, b;
+    bool ok = true;
+
+    {
+	Timeline t( file, 100, 300 );
+
+	std::thread ta( run_design, &a, &t, "design a" );
+	std::thread tb( run_design, &b, &t, "design b" );
+
+	ta.join();
+	tb.join();
+
+	printf("%llu records\n", (unsigned long long) t.n_records());
+	ok = t.save();
+    }
+
+    std::ifstream in(file);
+    std::string line;
+    int begins = 0, ends = 0, commits = 0, names = 0, outside = 0, counters = 0;
+
+    while(std::getline(in, line))
+    {
+	size_t p = line.find("\"time\":");
+
+	if(p != std::string::npos)
+	{
+	    long long t = atoll( line.c_str() + p + 7 );
+	    if(t < 100 || t >= 300)
+		outside++;
+	}
+
+	if(line.find("\"ph\":\"B\"") != std::string::npos)
+	    begins++;
+	if(line.find("\"ph\":\"E\"") != std::string::npos)
+	    ends++;
+	if(line.find("\"ph\":\"C\"") != std::string::npos)
+	    counters++;
+	if(line.find("\"cat\":\"commit\"") != std::string::npos)
+	    commits++;
+	if(line.find("\"name\":\"design ") != std::string::npos)
+	    names++;
+    }
+
+    printf("%d begins, %d ends, %d commits, %d time advances, %d thread names, %d outside of the window\n",
+	   begins, ends, commits, counters, names, outside);
+
+    // 10 rising edges per design in the window, each changing the counter
+    ok = ok && begins && begins == ends && commits >= 2 * (10 + 20) && counters > 0 && names == 2 && !outside;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+#include "sim.h"
+
+/*
+ Request/acknowledge handshake with a timeout per transaction instead of a
+ watchdog process. The responder acknowledges after a growing delay, so the
+ later requests time out.
+*/
+
+Logic clk(1,"clk");
+Logic req(1,"req");
+Logic ack(1,"ack");
+Logic irq(1,"irq");
+
+const int n_requests = 6, timeout = 50;
+const int delays[n_requests] = { 10, 30, 45, 60, 80, 20 };
+
+int n_acked, n_timeouts, n_errors;
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(5);
+    }
+    return 0;
+}
+
+int proc_requester(Context *c)
+{
+    for(int i = 0; i < n_requests; i++)
+    {
+	int64_t start = c->m_sim->m_time;
+
+	c->assign(req, LogicValue(1, 1));
+
+	Context::WakeReason r = c->wait_posedge(ack, timeout);
+	int64_t elapsed = c->m_sim->m_time - start;
+
+	if(r == Context::WAKE_EDGE)
+	{
+	    n_acked++;
+	    if(delays[i] >= timeout || elapsed != delays[i])
+		n_errors++;
+	} else {
+	    n_timeouts++;
+	    if(delays[i] < timeout || elapsed != timeout)
+		n_errors++;
+	}
+
+	printf("%-8lld: request %d: %s after %lld\n", (long long) c->m_sim->m_time, i,
+	       r == Context::WAKE_EDGE ? "ack" : "timeout", (long long) elapsed);
+
+	c->assign(req, LogicValue(1, 0));
+
+	// let a late acknowledge go by
+	std::set<SigBase *> quiet;
+	quiet.insert(&irq);
+	if( c->wait_signal(quiet, 100) != Context::WAKE_TIMEOUT )
+	    n_errors++;
+    }
+
+    c->finish();
+    return 0;
+}
+
+int proc_responder(Context *c)
+{
+    for(int i = 0; i < n_requests; i++)
+    {
+	do
+	    c->wait_signal(req);
+	while(!req.value());
+
+	c->wait(delays[i]);
+	c->assign(ack, LogicValue(1, 1));
+	c->wait(1);
+	c->assign(ack, LogicValue(1, 0));
+    }
+
+    // wait_any: clock edges keep coming, irq never does
+    std::set<SigBase *> signals;
+    std::set<Logic *> edges;
+
+    signals.insert(&irq);
+    edges.insert(&clk);
+
+    if( c->wait_any(signals, edges, 1000) != Context::WAKE_EDGE || c->m_trigger != &clk )
+	n_errors++;
+
+    edges.clear();
+    if( c->wait_any(signals, edges, 7) != Context::WAKE_TIMEOUT )
+	n_errors++;
+
+    c->finish();
+    return 0;
+}
+
+int main()
+{
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&req);
+    sim.add_signal(&ack);
+    sim.add_signal(&irq);
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_requester, "requester", false);
+    sim.add_process(proc_responder, "responder", false);
+
+    printf("Running simulation...\n");
+
+    sim.run(2000);
+
+    printf("%d acked (should be 4), %d timeouts (should be 2), %d errors\n", n_acked, n_timeouts, n_errors);
+
+    return (n_acked == 4 && n_timeouts == 2 && !n_errors) ? 0 : 1;
+}
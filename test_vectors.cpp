@@ -0,0 +1,86 @@
+#include "sim.h"
+#include "stimulus.h"
+
+/*
+ Drives a combinational adder from a vector file, one row per clock, and
+ checks its output against the expected column of the same file.
+*/
+
+Logic clk(1,"clk");
+Logic a(16,"a");
+Logic b(16,"b");
+Logic sum(16,"sum");
+
+const int n_vectors = 1000;
+
+int proc_clk(Context *c)
+{
+    for(;;)
+    {
+	c->assign( clk, ~clk );
+	c->wait(10);
+    }
+    return 0;
+}
+
+int proc_adder(Context *c)
+{
+    for(;;)
+    {
+	std::set<SigBase*> sense_list;
+
+	sense_list.insert(&a);
+	sense_list.insert(&b);
+
+	c->wait_signal( sense_list );
+	c->assign( sum, a + b );
+    }
+    return 0;
+}
+
+int main()
+{
+    FILE *f = fopen("test_vectors.csv", "w");
+
+    fprintf(f, "a, b, sum\n");
+    for(int i = 0; i < n_vectors; i++)
+    {
+	int x = (i * 7919) & 0xffff, y = (i * 104729) & 0xffff;
+	fprintf(f, "%d, 0x%x, %d\n", x, y, (x + y) & 0xffff);
+    }
+    fclose(f);
+
+    if( !VectorFile::convert_csv("test_vectors.csv", "test_vectors.vec") )
+    {
+	printf("conversion failed\n");
+	return 1;
+    }
+
+    Simulation sim;
+
+    sim.add_signal(&clk);
+    sim.add_signal(&a);
+    sim.add_signal(&b);
+    sim.add_signal(&sum);
+
+    clk.initial( Logic::from_int(0) );
+
+    sim.add_process(proc_clk, "clock_gen", false);
+    sim.add_process(proc_adder, "adder", false);
+
+    StimulusDriver stim(&sim, "test_vectors.vec", &clk);
+    ResponseChecker check(&sim, "test_vectors.vec", &clk);
+
+    stim.bind("a", &a);
+    stim.bind("b", &b);
+    check.bind("sum", &sum);
+
+    printf("Running simulation...\n");
+
+    sim.run(20 * (n_vectors + 2));
+
+    printf("%llu vectors checked (should be %d), %llu errors\n", (unsigned long long) check.checked(),
+	   n_vectors, (unsigned long long) check.errors());
+
+    return (check.checked() == n_vectors && check.errors() == 0) ? 0 : 1;
+}
@@ -0,0 +1,356 @@
+#ifndef __TIMELINE_H
+#define __TIMELINE_H
+
+#include <ctime>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "sim.h"
+
+/*
+ Scheduler timeline in the Chrome trace-event format (chrome://tracing,
+ ui.perfetto.dev): process resumes as slices nested in delta cycle slices,
+ signal commits as instant events and time advances as a counter, all on a
+ wall clock axis with the simulation time in the event arguments.
+
+ Every thread that records gets its own buffer: a list of fixed-size chunks
+ only that thread appends to, so recording takes no lock (only the first
+ event of a thread, and the first sight of a name, do). Several Simulations,
+ e.g. partitions on their own threads, may share one Timeline.
+
+ Only time steps in [from, to) are recorded. The kernel tests a single flag
+ (Simulation::m_tracing, updated when the time advances) before every hook,
+ so an attached Timeline costs nothing outside of its window and a missing
+ one costs nothing at all.
+
+ save() must not run concurrently with a simulation that records.
+*/
+
+class Timeline
+{
+public:
+    enum Kind {
+	RESUME = 0,
+	YIELD,
+	DELTA_BEGIN,
+	DELTA_END,
+	COMMIT,
+	TIME
+    };
+
+    struct Record
+    {
+	uint64_t m_wall;	// ns since the Timeline was created
+	int64_t m_time;
+	uint64_t m_value;	// delta number, committed value
+	int32_t m_name;
+	int32_t m_kind;
+    };
+
+    Timeline( const std::string filename, int64_t from = 0, int64_t to = Simulation::c_noEvent ) :
+	m_filename( filename ), m_from( from ), m_to( to ), m_saved( false )
+    {
+	m_serial = ++serial();
+	m_start = wall();
+    }
+
+    ~Timeline()
+    {
+	if(!m_saved)
+	    save();
+
+	BOOST_FOREACH(Buffer *b, m_buffers)
+	{
+	    BOOST_FOREACH(Record *chunk, b->m_chunks)
+		delete[] chunk;
+	    delete b;
+	}
+    }
+
+    void attach( Simulation *sim )
+    {
+	sim->m_timeline = this;
+	sim->m_tracing = covers( sim->m_time );
+    }
+
+    void detach( Simulation *sim )
+    {
+	sim->m_timeline = NULL;
+	sim->m_tracing = false;
+    }
+
+    bool covers( int64_t time ) const
+    {
+	return time >= m_from && time < m_to;
+    }
+
+    // the name of the calling thread's track
+    void name_thread( const std::string name )
+    {
+	buffer()->m_name = name;
+    }
+
+    /**
+     * Function resume()
+     * Records the start of a process slice; returns the name to close it
+     * with, as the process may retire (and its Context be reused) before
+     * it yields.
+     */
+    int resume( const Context *ctx, int64_t time )
+    {
+	Buffer *b = buffer();
+	NamedContext& n = b->m_contexts[ctx];
+
+	// pooled contexts are renamed by every spawn()
+	if(n.m_id < 0 || n.m_name != ctx->m_name)
+	{
+	    n.m_name = ctx->m_name;
+	    n.m_id = intern( ctx->m_name );
+	}
+
+	add( b, RESUME, time, n.m_id, 0 );
+	return n.m_id;
+    }
+
+    void yield( int name, int64_t time )
+    {
+	add( buffer(), YIELD, time, name, 0 );
+    }
+
+    void delta_begin( int64_t time, int delta )
+    {
+	add( buffer(), DELTA_BEGIN, time, -1, delta );
+    }
+
+    void delta_end( int64_t time, int delta )
+    {
+	add( buffer(), DELTA_END, time, -1, delta );
+    }
+
+    void commit( const SigBase *sig, int64_t time )
+    {
+	Buffer *b = buffer();
+	std::unordered_map<const SigBase *, int>::iterator i = b->m_signals.find(sig);
+
+	if(i == b->m_signals.end())
+	    i = b->m_signals.insert( std::make_pair( sig, intern( sig->name() ) ) ).first;
+
+	add( b, COMMIT, time, i->second, sig->raw_value() );
+    }
+
+    void time( int64_t time )
+    {
+	add( buffer(), TIME, time, -1, 0 );
+    }
+
+    uint64_t n_records()
+    {
+	std::lock_guard<std::mutex> guard(m_lock);
+	uint64_t n = 0;
+
+	BOOST_FOREACH(Buffer *b, m_buffers)
+	    n += b->m_chunks.empty() ? 0 : (b->m_chunks.size() - 1) * c_chunk + b->m_used;
+	return n;
+    }
+
+    /**
+     * Function save()
+     * Writes all buffers as a trace-event JSON file, one track per thread.
+     * Returns false if the file could not be written.
+     */
+    bool save()
+    {
+	std::lock_guard<std::mutex> guard(m_lock);
+	FILE *f = fopen( m_filename.c_str(), "wb" );
+
+	m_saved = true;
+
+	if(!f)
+	    return false;
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"simulation\"}}");
+
+	for(int tid = 0; tid < m_buffers.size(); tid++)
+	{
+	    Buffer *b = m_buffers[tid];
+
+	    fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+		    tid, escape( b->m_name ).c_str() );
+
+	    for(int c = 0; c < b->m_chunks.size(); c++)
+	    {
+		int n = c == b->m_chunks.size() - 1 ? b->m_used : c_chunk;
+
+		for(int i = 0; i < n; i++)
+		    write_record( f, tid, b->m_chunks[c][i] );
+	    }
+	}
+
+	fprintf(f, "\n]}\n");
+	return fclose(f) == 0;
+    }
+
+private:
+    static const int c_chunk = 16384;
+
+    struct NamedContext
+    {
+	NamedContext() : m_id( -1 ) {}
+
+	int m_id;
+	std::string m_name;
+    };
+
+    // one per recording thread, appended to by that thread only
+    struct Buffer
+    {
+	std::thread::id m_thread;
+	std::string m_name;
+	std::vector<Record *> m_chunks;
+	int m_used;
+	// names already interned by this thread
+	std::unordered_map<const Context *, NamedContext> m_contexts;
+	std::unordered_map<const SigBase *, int> m_signals;
+    };
+
+    // tells a Timeline from an earlier one at the same address
+    static std::atomic<uint64_t>& serial()
+    {
+	static std::atomic<uint64_t> s( 0 );
+	return s;
+    }
+
+    static uint64_t wall()
+    {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    Buffer *buffer()
+    {
+	static thread_local uint64_t t_serial = 0;
+	static thread_local Buffer *t_buffer = NULL;
+
+	if(t_serial == m_serial)
+	    return t_buffer;
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	Buffer *b = NULL;
+
+	// back from recording into another Timeline
+	BOOST_FOREACH(Buffer *o, m_buffers)
+	    if(o->m_thread == std::this_thread::get_id())
+		b = o;
+
+	if(!b)
+	{
+	    char name[32];
+
+	    b = new Buffer;
+	    b->m_thread = std::this_thread::get_id();
+	    b->m_used = c_chunk;
+	    snprintf(name, sizeof(name), "thread %d", (int) m_buffers.size());
+	    b->m_name = name;
+	    m_buffers.push_back(b);
+	}
+
+	t_serial = m_serial;
+	t_buffer = b;
+	return b;
+    }
+
+    int intern( const std::string& name )
+    {
+	std::lock_guard<std::mutex> guard(m_lock);
+	std::unordered_map<std::string, int>::iterator i = m_nameIds.find(name);
+
+	if(i != m_nameIds.end())
+	    return i->second;
+
+	m_names.push_back(name);
+	m_nameIds[name] = m_names.size() - 1;
+	return m_names.size() - 1;
+    }
+
+    void add( Buffer *b, Kind kind, int64_t time, int name, uint64_t value )
+    {
+	if(b->m_used == c_chunk)
+	{
+	    b->m_chunks.push_back( new Record[c_chunk] );
+	    b->m_used = 0;
+	}
+
+	Record& r = b->m_chunks.back()[ b->m_used++ ];
+
+	r.m_wall = wall() - m_start;
+	r.m_time = time;
+	r.m_value = value;
+	r.m_name = name;
+	r.m_kind = kind;
+    }
+
+    static std::string escape( const std::string& s )
+    {
+	std::string rv;
+
+	BOOST_FOREACH(char c, s)
+	{
+	    if(c == '"' || c == '\\')
+		rv += '\\';
+	    if((unsigned char) c >= 0x20)
+		rv += c;
+	}
+	return rv;
+    }
+
+    void write_record( FILE *f, int tid, const Record& r )
+    {
+	// microseconds, with ns resolution
+	double ts = r.m_wall / 1000.0;
+	const char *name = r.m_name >= 0 ? m_names[r.m_name].c_str() : "";
+
+	switch(r.m_kind)
+	{
+	    case RESUME:
+		fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"process\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"time\":%lld}}",
+			escape(name).c_str(), ts, tid, (long long) r.m_time);
+		break;
+
+	    case DELTA_BEGIN:
+		fprintf(f, ",\n{\"name\":\"delta\",\"cat\":\"delta\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"time\":%lld,\"delta\":%llu}}",
+			ts, tid, (long long) r.m_time, (unsigned long long) r.m_value);
+		break;
+
+	    case YIELD:
+	    case DELTA_END:
+		fprintf(f, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ts, tid);
+		break;
+
+	    case COMMIT:
+		fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"commit\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"time\":%lld,\"value\":%llu}}",
+			escape(name).c_str(), ts, tid, (long long) r.m_time, (unsigned long long) r.m_value);
+		break;
+
+	    case TIME:
+		fprintf(f, ",\n{\"name\":\"time\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"time\":%lld}}",
+			ts, tid, (long long) r.m_time);
+		break;
+	}
+    }
+
+    std::string m_filename;
+    int64_t m_from, m_to;
+    bool m_saved;
+    uint64_t m_serial, m_start;
+
+    std::mutex m_lock;
+    std::vector<Buffer *> m_buffers;
+    std::vector<std::string> m_names;
+    std::unordered_map<std::string, int> m_nameIds;
+};
+
+#endif
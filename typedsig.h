@@ -0,0 +1,161 @@
+#ifndef __TYPEDSIG_H
+#define __TYPEDSIG_H
+
+#include <cstring>
+#include <type_traits>
+
+#include "sim.h"
+
+/*
+ Signals of plain C++ types for behavioural models: Signal<int>,
+ Signal<double>, Signal<SomeEnum>, Signal<SomeStruct>...
+
+ The current and the next value are stored inline. c->assign(sig, v) copies
+ v into the next value and posts the signal once per delta - there is no
+ driver object, no masking and no allocation. The commit detects a change
+ with memcmp(), so T must be trivially copyable and should have no padding
+ bytes (they would make equal values compare different).
+
+ TypedSigBase is the type-independent part the VCD writer sees: a Signal
+ can be dumped as a real (arithmetic types) or as its raw bytes.
+*/
+
+class TypedSigBase : public SigBase
+{
+public:
+    enum TraceFormat {
+	TRACE_NONE = 0,
+	TRACE_REAL = 1,
+	TRACE_BITS = 2
+    };
+
+    TypedSigBase( const std::string name ) : SigBase(name), m_trace( TRACE_NONE ) {}
+
+    // the value as a double, for TRACE_REAL
+    virtual double real_value() const = 0;
+    // the value bytes (native order) and their count, for TRACE_BITS
+    virtual const void *bytes() const = 0;
+    virtual int n_bytes() const = 0;
+
+    void trace( TraceFormat format )
+    {
+	m_trace = format;
+    }
+
+    TraceFormat m_trace;
+};
+
+template<class T>
+class Signal : public TypedSigBase
+{
+    static_assert( std::is_trivially_copyable<T>::value, "Signal<T> needs a trivially copyable T" );
+
+public:
+    typedef T Type;
+
+    Signal( const std::string name = "?" ) : TypedSigBase(name), m_value(), m_next(), m_posted( false ), m_changed( false ) {}
+
+    const T& value() const
+    {
+	return m_value;
+    }
+
+    operator const T&() const
+    {
+	return m_value;
+    }
+
+    void initial( const T& value )
+    {
+	m_value = m_next = value;
+    }
+
+    // Context::assign() for typed signals: the value is visible after the commit
+    void write( Simulation *sim, const T& value )
+    {
+	m_next = value;
+
+	if(!m_posted)
+	{
+	    m_posted = true;
+	    sim->post(this);
+	}
+    }
+
+    virtual bool update()
+    {
+	if(!m_posted)
+	    return false;
+
+	m_posted = false;
+	m_changed = memcmp( &m_next, &m_value, sizeof(T) ) != 0;
+	if(m_changed)
+	    memcpy( &m_value, &m_next, sizeof(T) );
+
+	return true;
+    }
+
+    virtual bool changed() const
+    {
+	return m_changed;
+    }
+
+    virtual void clear_changed()
+    {
+	m_changed = false;
+    }
+
+    virtual SigBase *clone() const
+    {
+	Signal<T> *s = new Signal<T>;
+	s->m_value = s->m_next = m_value;
+	return s;
+    }
+
+    virtual void copy_value( const SigBase *b )
+    {
+	const Signal<T> *s = static_cast<const Signal<T> *>( b );
+
+	m_changed = memcmp( &s->m_value, &m_value, sizeof(T) ) != 0;
+	m_value = s->m_value;
+    }
+
+    // the first 8 bytes, for value change callbacks
+    virtual uint64_t raw_value() const
+    {
+	uint64_t v = 0;
+	memcpy( &v, &m_value, sizeof(T) < sizeof(v) ? sizeof(T) : sizeof(v) );
+	return v;
+    }
+
+    virtual double real_value() const
+    {
+	return to_real( m_value, std::integral_constant<bool, std::is_arithmetic<T>::value || std::is_enum<T>::value>() );
+    }
+
+    virtual const void *bytes() const
+    {
+	return &m_value;
+    }
+
+    virtual int n_bytes() const
+    {
+	return sizeof(T);
+    }
+
+private:
+    static double to_real( const T& v, std::true_type )
+    {
+	return (double) v;
+    }
+
+    static double to_real( const T& v, std::false_type )
+    {
+	return 0.0;
+    }
+
+    T m_value, m_next;
+    bool m_posted, m_changed;
+};
+
+#endif
@@ -3,14 +3,19 @@
 
 #include <cstdio>
 #include "sim.h"
+#include "memory.h"
+#include "typedsig.h"
 
 class VCDWriter
 {
     public:
-	VCDWriter(const std::string filename, Simulation *s)
+	// only: the signals to dump, all of them if empty - e.g. the boundary
+	// of a block, for a later Replay of that block alone
+	VCDWriter(const std::string filename, Simulation *s, const std::set<SigBase *>& only = std::set<SigBase *>())
 	{
 	    m_file = fopen(filename.c_str(),"wb");
 	    m_sim = s;
+	    m_only = only;
 
 	    fprintf(m_file,"$date\n");
 	    fprintf(m_file,"Wed Sep 23 14:38:27 2015\n");
@@ -25,18 +30,40 @@ class VCDWriter
 	    
 	    BOOST_FOREACH(SigBase *s, m_sim->m_signals)
 	    {
+		if(!dumped(s))
+		    continue;
+
 		if(Logic *l = dynamic_cast<Logic *>(s) )
 		{
 		    if(l->m_bits==1)
-			fprintf(m_file, "$var reg 1 %04x %s $end\n",  l->m_id, l->m_name.c_str() );
+			fprintf(m_file, "$var reg 1 %04x %s $end\n",  l->m_id, l->name().c_str() );
 		    else
-			fprintf(m_file, "$var reg %d %04x %s [%d:0] $end\n", l->m_bits, l->m_id, l->m_name.c_str(), l->m_bits-1 );
+			fprintf(m_file, "$var reg %d %04x %s [%d:0] $end\n", l->m_bits, l->m_id, l->name().c_str(), l->m_bits-1 );
+		} else if(Memory *m = dynamic_cast<Memory *>(s) ) {
+		    // one variable per traced word
+		    for(uint64_t addr = 0; addr < m->m_traceWords; addr++)
+			fprintf(m_file, "$var reg %d %04x_%llx %s[%llu] $end\n", m->m_bits, m->m_id,
+				(unsigned long long) addr, m->name().c_str(), (unsigned long long) addr );
+
+		    if(m->m_traceWords)
+		    {
+			m->m_traced = true;
+			m_memories.push_back(m);
+		    }
+		} else if(TypedSigBase *t = dynamic_cast<TypedSigBase *>(s) ) {
+		    if(t->m_trace == TypedSigBase::TRACE_REAL)
+			fprintf(m_file, "$var real 64 %04x %s $end\n", t->m_id, t->name().c_str() );
+		    else if(t->m_trace == TypedSigBase::TRACE_BITS)
+			fprintf(m_file, "$var reg %d %04x %s [%d:0] $end\n", t->n_bytes() * 8, t->m_id, t->name().c_str(), t->n_bytes() * 8 - 1 );
+
+		    if(t->m_trace != TypedSigBase::TRACE_NONE)
+			m_typed.push_back(t);
 		}
 	    }
 	    fprintf(m_file, "$upscope $end\n");
 	    fprintf(m_file, "$enddefinitions $end\n");
 	    m_sim->set_writer(this);
-
+	    m_initialDump = true;
 	}
 
 	string to_bin(uint64_t value, int bits)
@@ -53,11 +80,59 @@ class VCDWriter
 	    fprintf(m_file,"#%d\n", m_sim->m_time);
 	    BOOST_FOREACH(SigBase *s, m_sim->m_signals)
 	    {
+		if(!dumped(s))
+		    continue;
+
 		if(Logic *l = dynamic_cast<Logic *>(s) )
 		{
 		    fprintf(m_file, "b%s %04x\n", to_bin(l->value(), l->m_bits).c_str(), l->m_id );
 		}
 	    }
+
+	    BOOST_FOREACH(TypedSigBase *t, m_typed)
+	    {
+		if(t->m_trace == TypedSigBase::TRACE_REAL)
+		{
+		    fprintf(m_file, "r%.16g %04x\n", t->real_value(), t->m_id );
+		    continue;
+		}
+
+		// most significant byte first, native order is little endian
+		const uint8_t *b = (const uint8_t *) t->bytes();
+		string bits;
+
+		for(int i = t->n_bytes() - 1; i >= 0; i--)
+		    bits += to_bin(b[i], 8);
+		fprintf(m_file, "b%s %04x\n", bits.c_str(), t->m_id );
+	    }
+
+	    // memories: all traced words once, then only the changed ones
+	    BOOST_FOREACH(Memory *m, m_memories)
+	    {
+		if(m_initialDump)
+		{
+		    for(uint64_t addr = 0; addr < m->m_traceWords; addr++)
+			dump_word(m, addr);
+		    m->take_trace_changes(m_words);
+		    continue;
+		}
+
+		m->take_trace_changes(m_words);
+		BOOST_FOREACH(uint64_t addr, m_words)
+		    dump_word(m, addr);
+	    }
+
+	    m_initialDump = false;
+	}
+
+	void dump_word(Memory *m, uint64_t addr)
+	{
+	    fprintf(m_file, "b%s %04x_%llx\n", to_bin(m->m_data[addr], m->m_bits).c_str(), m->m_id, (unsigned long long) addr );
+	}
+
+	bool dumped(SigBase *s) const
+	{
+	    return m_only.empty() || m_only.count(s);
 	}
 
 	void finish()
@@ -67,5 +142,11 @@ class VCDWriter
 	Simulation *m_sim;
 	FILE *m_file;
 
+	std::vector<Memory *> m_memories;
+	std::vector<TypedSigBase *> m_typed;
+	std::vector<uint64_t> m_words;
+	bool m_initialDump;
+	std::set<SigBase *> m_only;
+
 };
 #endif
@@ -0,0 +1,27 @@
+#include "wavecmp.h"
+
+// compares two VCD dumps, streaming both; prints the first difference
+
+int main(int argc, char *argv[])
+{
+    if(argc != 3)
+    {
+	fprintf(stderr, "usage: %s expected.vcd actual.vcd\n", argv[0]);
+	return 2;
+    }
+
+    WaveMismatch mismatch;
+    std::string error;
+
+    if( compare_vcd(argv[1], argv[2], mismatch, error) )
+	return 0;
+
+    if(mismatch.m_name.empty())
+    {
+	fprintf(stderr, "%s: %s\n", argv[0], error.c_str());
+	return 2;
+    }
+
+    printf("%s\n", mismatch.describe().c_str());
+    return 1;
+}
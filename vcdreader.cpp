@@ -0,0 +1,285 @@
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "vcdreader.h"
+
+// consumed input is released in steps of this size
+static const size_t c_releaseStep = 16 << 20;
+
+static bool is_space( char c )
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool pack_code( const char *id, int len, uint64_t& key )
+{
+    if(len > 8)
+	return false;
+
+    key = 0;
+    memcpy( &key, id, len );
+    return true;
+}
+
+VCDReader::VCDReader() :
+    m_time( 0 ), m_data( NULL ), m_pos( NULL ), m_end( NULL ), m_size( 0 ), m_released( NULL ), m_nCodes( 0 )
+{
+}
+
+VCDReader::~VCDReader()
+{
+    if(m_data)
+	munmap( (void *) m_data, m_size );
+}
+
+bool VCDReader::open( const std::string filename )
+{
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    struct stat st;
+
+    if(fd < 0 || fstat( fd, &st ) < 0 || st.st_size == 0)
+    {
+	if(fd >= 0)
+	    close(fd);
+	m_error = "cannot read " + filename;
+	return false;
+    }
+
+    void *p = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close(fd);
+
+    if(p == MAP_FAILED)
+    {
+	m_error = "cannot map " + filename;
+	return false;
+    }
+
+    madvise( p, st.st_size, MADV_SEQUENTIAL );
+
+    m_data = m_pos = m_released = (const char *) p;
+    m_size = st.st_size;
+    m_end = m_data + m_size;
+
+    return parse_header();
+}
+
+bool VCDReader::token( const char *& start, int& len )
+{
+    while(m_pos < m_end && is_space(*m_pos))
+	m_pos++;
+
+    if(m_pos == m_end)
+	return false;
+
+    start = m_pos;
+    while(m_pos < m_end && !is_space(*m_pos))
+	m_pos++;
+
+    len = m_pos - start;
+    return true;
+}
+
+bool VCDReader::skip_to_end()
+{
+    const char *t;
+    int len;
+
+    while(token(t, len))
+	if(len == 4 && !memcmp(t, "$end", 4))
+	    return true;
+
+    m_error = "missing $end";
+    return false;
+}
+
+bool VCDReader::parse_header()
+{
+    std::vector<std::string> scopes;
+    const char *t;
+    int len;
+
+    while(token(t, len))
+    {
+	std::string kw(t, len);
+
+	if(kw == "$enddefinitions")
+	    return skip_to_end();
+
+	if(kw == "$scope")
+	{
+	    const char *name;
+
+	    // type, name
+	    if(!token(t, len) || !token(name, len))
+		break;
+	    scopes.push_back( std::string(name, len) );
+
+	    if(!skip_to_end())
+		return false;
+	} else if(kw == "$upscope") {
+	    if(!scopes.empty())
+		scopes.pop_back();
+
+	    if(!skip_to_end())
+		return false;
+	} else if(kw == "$var") {
+	    const char *type, *width, *id, *ref;
+	    int type_len, width_len, id_len, ref_len;
+
+	    if(!token(type, type_len) || !token(width, width_len) || !token(id, id_len) || !token(ref, ref_len))
+		break;
+
+	    Var v;
+
+	    // the top scope is the design itself
+	    for(int i = 1; i < scopes.size(); i++)
+		v.m_name += scopes[i] + ".";
+	    v.m_name += std::string(ref, ref_len);
+	    v.m_bits = atoi( std::string(width, width_len).c_str() );
+
+	    v.m_code = lookup( id, id_len );
+	    if(v.m_code < 0)
+	    {
+		uint64_t key;
+
+		v.m_code = m_nCodes++;
+		if(pack_code( id, id_len, key ))
+		    m_shortCodes[key] = v.m_code;
+		else
+		    m_longCodes[ std::string(id, id_len) ] = v.m_code;
+	    }
+
+	    m_names[v.m_name] = v.m_code;
+	    m_vars.push_back(v);
+
+	    // an optional bit range follows the reference
+	    if(!skip_to_end())
+		return false;
+	} else if(kw[0] == '$') {
+	    // $date, $version, $timescale, $comment...
+	    if(!skip_to_end())
+		return false;
+	} else {
+	    break;
+	}
+    }
+
+    m_error = "malformed header";
+    return false;
+}
+
+int VCDReader::lookup( const char *id, int len ) const
+{
+    uint64_t key;
+
+    if(pack_code( id, len, key ))
+    {
+	std::unordered_map<uint64_t, int>::const_iterator i = m_shortCodes.find(key);
+	return i == m_shortCodes.end() ? -1 : i->second;
+    }
+
+    std::map<std::string, int>::const_iterator i = m_longCodes.find( std::string(id, len) );
+    return i == m_longCodes.end() ? -1 : i->second;
+}
+
+int VCDReader::find( const std::string name ) const
+{
+    std::map<std::string, int>::const_iterator i = m_names.find(name);
+
+    return i == m_names.end() ? -1 : i->second;
+}
+
+void VCDReader::release()
+{
+    const char *upto = m_data + ( (m_pos - m_data) & ~(c_releaseStep - 1) );
+
+    if(upto > m_released)
+    {
+	madvise( (void *) m_released, upto - m_released, MADV_DONTNEED );
+	m_released = upto;
+    }
+}
+
+bool VCDReader::next( Change& change )
+{
+    const char *t;
+    int len;
+
+    while(token(t, len))
+    {
+	const char *id;
+	int id_len;
+
+	change.m_value = 0;
+	change.m_unknown = 0;
+
+	switch(*t)
+	{
+	    case '#':
+		m_time = strtoll( t + 1, NULL, 10 );
+		if(m_pos - m_released >= c_releaseStep)
+		    release();
+		continue;
+
+	    case '$':
+		// $dumpvars, $dumpall... just bracket changes; $comment holds text
+		if(len == 8 && !memcmp(t, "$comment", 8) && !skip_to_end())
+		    return false;
+		continue;
+
+	    case 'b': case 'B':
+		for(int i = 1; i < len; i++)
+		{
+		    change.m_value <<= 1;
+		    change.m_unknown <<= 1;
+
+		    if(t[i] == '1')
+			change.m_value |= 1;
+		    else if(t[i] != '0')
+			change.m_unknown |= 1;
+		}
+
+		if(!token(id, id_len))
+		    break;
+		change.m_code = lookup( id, id_len );
+		change.m_time = m_time;
+		return true;
+
+	    case 'r': case 'R':
+	    {
+		// real: the bits of the double
+		double v = strtod( std::string(t + 1, len - 1).c_str(), NULL );
+		memcpy( &change.m_value, &v, sizeof(v) );
+
+		if(!token(id, id_len))
+		    break;
+		change.m_code = lookup( id, id_len );
+		change.m_time = m_time;
+		return true;
+	    }
+
+	    case 's': case 'S':
+		// strings are not compared
+		token(id, id_len);
+		continue;
+
+	    case '0': case '1': case 'x': case 'X': case 'z': case 'Z':
+		change.m_value = *t == '1' ? 1 : 0;
+		change.m_unknown = (*t == '0' || *t == '1') ? 0 : 1;
+		change.m_code = lookup( t + 1, len - 1 );
+		change.m_time = m_time;
+		return true;
+
+	    default:
+		break;
+	}
+
+	m_error = "syntax error near \"" + std::string(t, len) + "\"";
+	return false;
+    }
+
+    return false;
+}
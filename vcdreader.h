@@ -0,0 +1,87 @@
+#ifndef __VCDREADER_H
+#define __VCDREADER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <stdint.h>
+
+/*
+ Streaming VCD parser over a read-only mapping of the file.
+
+ The header is parsed once into the variable list, with every identifier
+ code resolved to a dense index; after that next() walks the value changes
+ without allocating. Consumed parts of the mapping are handed back to the
+ kernel as the reader moves on, so the resident memory stays bounded no
+ matter how large the dump is.
+*/
+
+class VCDReader
+{
+public:
+    struct Var
+    {
+	// hierarchical name below the top scope, e.g. "counter" or "cpu.pc"
+	std::string m_name;
+	int m_bits;
+	// index of the identifier code; aliased variables share one
+	int m_code;
+    };
+
+    struct Change
+    {
+	int64_t m_time;
+	int m_code;
+	uint64_t m_value;
+	// bits that were x or z (they read as 0 in m_value)
+	uint64_t m_unknown;
+    };
+
+    VCDReader();
+    ~VCDReader();
+
+    // maps filename and parses its header
+    bool open( const std::string filename );
+
+    /**
+     * Function next()
+     * Next value change in file order. Returns false at the end of the dump
+     * (or on a syntax error, see m_error).
+     */
+    bool next( Change& change );
+
+    // identifier code of a variable, -1 if there is none by that name
+    int find( const std::string name ) const;
+
+    int n_codes() const
+    {
+	return m_nCodes;
+    }
+
+    std::vector<Var> m_vars;
+    std::string m_error;
+
+    // time of the last #timestamp read
+    int64_t m_time;
+
+private:
+    bool parse_header();
+    bool token( const char *& start, int& len );
+    bool skip_to_end();
+    int lookup( const char *id, int len ) const;
+    void release();
+
+    const char *m_data, *m_pos, *m_end;
+    size_t m_size;
+    // start of the part of the mapping still resident
+    const char *m_released;
+
+    int m_nCodes;
+    // codes of at most 8 characters packed into an integer, longer ones by name
+    std::unordered_map<uint64_t, int> m_shortCodes;
+    std::map<std::string, int> m_longCodes;
+    std::map<std::string, int> m_names;
+};
+
+#endif
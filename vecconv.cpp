@@ -0,0 +1,21 @@
+#include "stimulus.h"
+
+// converts a CSV vector file into the memory-mappable format used by
+// StimulusDriver and ResponseChecker
+
+int main(int argc, char *argv[])
+{
+    if(argc != 3)
+    {
+	fprintf(stderr, "usage: %s input.csv output.vec\n", argv[0]);
+	return 1;
+    }
+
+    if( !VectorFile::convert_csv(argv[1], argv[2]) )
+    {
+	fprintf(stderr, "%s: conversion of %s failed\n", argv[0], argv[1]);
+	return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,1116 @@
+/*
+ vlog2sim - translates a synthesizable Verilog subset into C++ processes for
+ this simulator.
+
+ Supported:
+  - one module per file, non-ANSI or ANSI port lists
+  - input/output/reg/wire declarations with [msb:0] ranges (up to 64 bits)
+  - continuous assignments (assign x = ...; wire [n:0] x = ...;)
+  - initial x = <constant>;
+  - always @(posedge clk) and always @(*) / @(a or b) blocks with
+    begin/end, if/else, blocking and non-blocking assignments to whole
+    signals, bits and part selects (negedge, asynchronous resets and
+    other edge lists are rejected)
+  - operators: + - * & | ^ ~ ! && || == != < <= > >= << >> ?: , unary
+    reductions, {concat} and {n{replicate}}, sized and unsized literals
+
+ Each always block and continuous assignment becomes one clocked or
+ combinational process (see Simulation::add_clocked_process()). Signals are
+ copied once into uint64_t locals, the body is straight-line integer code with
+ widths and masks resolved at translation time, and the outputs are assigned
+ at the end. Sensitivity lists of combinational processes are computed here.
+
+ usage: vlog2sim input.v output.h
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+struct Token
+{
+    enum Kind { IDENT, NUMBER, OP, END };
+
+    Kind m_kind;
+    string m_text;
+    int m_line;
+};
+
+class Lexer
+{
+public:
+    Lexer( const string& src ) : m_src( src ), m_pos( 0 ), m_line( 1 ) {}
+
+    vector<Token> tokenize()
+    {
+	vector<Token> rv;
+
+	for(;;)
+	{
+	    skip_space();
+
+	    Token t;
+	    t.m_line = m_line;
+
+	    if(m_pos >= m_src.size())
+	    {
+		t.m_kind = Token::END;
+		rv.push_back(t);
+		return rv;
+	    }
+
+	    char c = m_src[m_pos];
+
+	    if(isalpha(c) || c == '_' || c == '$')
+	    {
+		t.m_kind = Token::IDENT;
+		while(m_pos < m_src.size() && (isalnum(m_src[m_pos]) || m_src[m_pos] == '_' || m_src[m_pos] == '$'))
+		    t.m_text += m_src[m_pos++];
+	    } else if(isdigit(c) || c == '\'') {
+		// 32, 6'd32, 1'b1, 'hff
+		t.m_kind = Token::NUMBER;
+		while(m_pos < m_src.size() && (isalnum(m_src[m_pos]) || m_src[m_pos] == '_' || m_src[m_pos] == '\''))
+		    t.m_text += m_src[m_pos++];
+	    } else {
+		static const char *ops[] = { "<=", ">=", "==", "!=", "&&", "||", "<<", ">>", NULL };
+
+		t.m_kind = Token::OP;
+		t.m_text = c;
+
+		for(int i = 0; ops[i]; i++)
+		    if(!m_src.compare(m_pos, 2, ops[i]))
+			t.m_text = ops[i];
+
+		m_pos += t.m_text.size();
+	    }
+
+	    rv.push_back(t);
+	}
+    }
+
+private:
+    void skip_space()
+    {
+	for(;;)
+	{
+	    while(m_pos < m_src.size() && isspace(m_src[m_pos]))
+		if(m_src[m_pos++] == '\n')
+		    m_line++;
+
+	    if(!m_src.compare(m_pos, 2, "//"))
+	    {
+		while(m_pos < m_src.size() && m_src[m_pos] != '\n')
+		    m_pos++;
+	    } else if(!m_src.compare(m_pos, 2, "/*")) {
+		size_t end = m_src.find("*/", m_pos + 2);
+		end = (end == string::npos) ? m_src.size() : end + 2;
+		for(; m_pos < end; m_pos++)
+		    if(m_src[m_pos] == '\n')
+			m_line++;
+	    } else
+		return;
+	}
+    }
+
+    const string& m_src;
+    size_t m_pos;
+    int m_line;
+};
+
+
+struct Expr
+{
+    enum Kind { NUMBER, IDENT, UNARY, BINARY, TERNARY, CONCAT, REPLICATE, BIT_SELECT, PART_SELECT };
+
+    Kind m_kind;
+    string m_op;
+    string m_name;
+    uint64_t m_value;
+    int m_width;	// literals: declared width, 0 if unsized
+    int m_msb, m_lsb;
+    vector<Expr *> m_args;
+};
+
+struct Stmt
+{
+    enum Kind { BLOCK, IF, ASSIGN };
+
+    Kind m_kind;
+    vector<Stmt *> m_body;	// BLOCK: statements, IF: then [, else]
+    Expr *m_cond;		// IF: condition
+    Expr *m_lhs, *m_rhs;	// ASSIGN: target (IDENT, BIT_SELECT or PART_SELECT) and value
+    bool m_blocking;
+};
+
+struct Signal
+{
+    string m_name;
+    int m_width;
+    bool m_hasInit;
+    Expr *m_init;
+};
+
+struct Process
+{
+    bool m_clocked;
+    string m_clock;
+    Stmt *m_body;
+};
+
+struct Module
+{
+    string m_name;
+    vector<string> m_order;
+    map<string, Signal> m_signals;
+    vector<Process> m_processes;
+};
+
+
+class Parser
+{
+public:
+    Parser( const vector<Token>& tokens ) : m_tok( tokens ), m_pos( 0 ) {}
+
+    Module *parse_module()
+    {
+	Module *m = new Module;
+	m_mod = m;
+
+	expect("module");
+	m->m_name = ident();
+
+	if(accept("("))
+	{
+	    // port list: plain names, or ANSI declarations
+	    while(!accept(")"))
+	    {
+		if(peek("input") || peek("output"))
+		    declaration(true);
+		else
+		    ident();
+		accept(",");
+	    }
+	}
+	expect(";");
+
+	while(!accept("endmodule"))
+	    item();
+
+	return m;
+    }
+
+private:
+    void item()
+    {
+	if(peek("input") || peek("output") || peek("reg") || peek("wire"))
+	{
+	    declaration(false);
+	} else if(accept("assign")) {
+	    do
+	    {
+		continuous( ident() );
+	    } while(accept(","));
+	    expect(";");
+	} else if(accept("initial")) {
+	    Stmt *s = statement();
+	    initials(s);
+	} else if(accept("always")) {
+	    Process p;
+
+	    expect("@");
+	    expect("(");
+
+	    if(accept("posedge"))
+	    {
+		p.m_clocked = true;
+		p.m_clock = ident();
+		check_signal(p.m_clock);
+		if(peek("or") || peek(","))
+		    error("only a single posedge clock is supported (no asynchronous resets)");
+		expect(")");
+	    } else {
+		// @(*) or @(a or b): sensitivity is derived from the body anyway,
+		// but edges would silently turn into combinational logic
+		p.m_clocked = false;
+		while(!accept(")"))
+		{
+		    if(peek("posedge") || peek("negedge") || peek("edge"))
+			error("unsupported edge '" + cur().m_text + "', only always @(posedge clk) is clocked");
+		    next();
+		}
+	    }
+
+	    p.m_body = statement();
+	    m_mod->m_processes.push_back(p);
+	} else
+	    error("unsupported module item '" + cur().m_text + "'");
+    }
+
+    // input/output [reg|wire] [range] names; reg/wire [range] name [= expr], ...;
+    void declaration(bool in_port_list)
+    {
+	next();
+	accept("reg") || accept("wire");
+
+	int width = 1;
+
+	if(accept("["))
+	{
+	    int msb = number_value(), lsb;
+	    expect(":");
+	    lsb = number_value();
+	    expect("]");
+
+	    if(lsb != 0 || msb < 0 || msb > 63)
+		error("only [msb:0] ranges of up to 64 bits are supported");
+	    width = msb + 1;
+	}
+
+	for(;;)
+	{
+	    string name = ident();
+	    add_signal(name, width);
+
+	    if(!in_port_list && accept("="))
+		continuous(name, false);
+
+	    if(in_port_list)
+	    {
+		// the next port may be a new declaration
+		if(!peek(",") || peek_at(1, "input") || peek_at(1, "output"))
+		    return;
+		expect(",");
+	    } else if(!accept(","))
+		break;
+	}
+
+	expect(";");
+    }
+
+    void continuous( const string& name, bool expect_eq = true )
+    {
+	if(expect_eq)
+	    expect("=");
+
+	check_signal(name);
+
+	Stmt *s = new Stmt;
+	s->m_kind = Stmt::ASSIGN;
+	s->m_lhs = ident_expr(name);
+	s->m_rhs = expression();
+	s->m_blocking = true;
+
+	Process p;
+	p.m_clocked = false;
+	p.m_body = s;
+	m_mod->m_processes.push_back(p);
+    }
+
+    void initials( Stmt *s )
+    {
+	if(s->m_kind == Stmt::BLOCK)
+	{
+	    BOOST_FOREACH(Stmt *b, s->m_body)
+		initials(b);
+	} else if(s->m_kind == Stmt::ASSIGN && s->m_lhs->m_kind == Expr::IDENT) {
+	    Signal& sig = m_mod->m_signals[s->m_lhs->m_name];
+	    sig.m_hasInit = true;
+	    sig.m_init = s->m_rhs;
+	} else
+	    error("initial blocks may only assign whole signals");
+    }
+
+    Stmt *statement()
+    {
+	Stmt *s = new Stmt;
+
+	if(accept("begin"))
+	{
+	    s->m_kind = Stmt::BLOCK;
+	    while(!accept("end"))
+		s->m_body.push_back(statement());
+	} else if(accept("if")) {
+	    s->m_kind = Stmt::IF;
+	    expect("(");
+	    s->m_cond = expression();
+	    expect(")");
+	    s->m_body.push_back(statement());
+	    if(accept("else"))
+		s->m_body.push_back(statement());
+	} else {
+	    s->m_kind = Stmt::ASSIGN;
+	    s->m_lhs = primary();
+
+	    if(s->m_lhs->m_kind != Expr::IDENT && s->m_lhs->m_kind != Expr::BIT_SELECT &&
+	       s->m_lhs->m_kind != Expr::PART_SELECT)
+		error("unsupported assignment target");
+
+	    if(accept("<="))
+		s->m_blocking = false;
+	    else
+	    {
+		expect("=");
+		s->m_blocking = true;
+	    }
+
+	    s->m_rhs = expression();
+	    expect(";");
+	}
+
+	return s;
+    }
+
+    // precedence climbing, loosest binding first
+    Expr *expression()
+    {
+	Expr *c = binary(0);
+
+	if(!accept("?"))
+	    return c;
+
+	Expr *e = new Expr;
+	e->m_kind = Expr::TERNARY;
+	e->m_args.push_back(c);
+	e->m_args.push_back(expression());
+	expect(":");
+	e->m_args.push_back(expression());
+	return e;
+    }
+
+    Expr *binary( int level )
+    {
+	static const char *levels[][5] = {
+	    { "||", NULL },
+	    { "&&", NULL },
+	    { "|", NULL },
+	    { "^", NULL },
+	    { "&", NULL },
+	    { "==", "!=", NULL },
+	    { "<", "<=", ">", ">=", NULL },
+	    { "<<", ">>", NULL },
+	    { "+", "-", NULL },
+	    { "*", NULL }
+	};
+	static const int n_levels = sizeof(levels) / sizeof(levels[0]);
+
+	if(level == n_levels)
+	    return unary();
+
+	Expr *lhs = binary(level + 1);
+
+	for(;;)
+	{
+	    const char *op = NULL;
+
+	    for(int i = 0; levels[level][i]; i++)
+		if(peek(levels[level][i]))
+		    op = levels[level][i];
+
+	    if(!op)
+		return lhs;
+
+	    next();
+
+	    Expr *e = new Expr;
+	    e->m_kind = Expr::BINARY;
+	    e->m_op = op;
+	    e->m_args.push_back(lhs);
+	    e->m_args.push_back(binary(level + 1));
+	    lhs = e;
+	}
+    }
+
+    Expr *unary()
+    {
+	static const char *ops[] = { "!", "~", "-", "&", "|", "^", NULL };
+
+	for(int i = 0; ops[i]; i++)
+	{
+	    if(accept(ops[i]))
+	    {
+		Expr *e = new Expr;
+		e->m_kind = Expr::UNARY;
+		e->m_op = ops[i];
+		e->m_args.push_back(unary());
+		return e;
+	    }
+	}
+
+	return primary();
+    }
+
+    Expr *primary()
+    {
+	if(accept("("))
+	{
+	    Expr *e = expression();
+	    expect(")");
+	    return e;
+	}
+
+	if(accept("{"))
+	{
+	    Expr *first = expression();
+
+	    if(accept("{"))
+	    {
+		// {n{a}}
+		Expr *e = new Expr;
+		e->m_kind = Expr::REPLICATE;
+		e->m_value = const_value(first);
+		e->m_args.push_back(expression());
+		expect("}");
+		expect("}");
+		return e;
+	    }
+
+	    Expr *e = new Expr;
+	    e->m_kind = Expr::CONCAT;
+	    e->m_args.push_back(first);
+	    while(accept(","))
+		e->m_args.push_back(expression());
+	    expect("}");
+	    return e;
+	}
+
+	if(cur().m_kind == Token::NUMBER)
+	    return number();
+
+	string name = ident();
+	check_signal(name);
+
+	if(!accept("["))
+	    return ident_expr(name);
+
+	Expr *index = expression();
+	Expr *e = new Expr;
+	e->m_name = name;
+
+	if(accept(":"))
+	{
+	    e->m_kind = Expr::PART_SELECT;
+	    e->m_msb = const_value(index);
+	    e->m_lsb = const_value(expression());
+	    if(e->m_msb < e->m_lsb)
+		error("part selects must be [msb:lsb]");
+	} else {
+	    e->m_kind = Expr::BIT_SELECT;
+	    e->m_args.push_back(index);
+	}
+
+	expect("]");
+	return e;
+    }
+
+    Expr *number()
+    {
+	string text = next().m_text;
+	Expr *e = new Expr;
+	size_t q = text.find('\'');
+	int base = 10;
+	string digits = text;
+
+	e->m_kind = Expr::NUMBER;
+	e->m_width = 0;
+
+	if(q != string::npos)
+	{
+	    e->m_width = q ? atoi(text.substr(0, q).c_str()) : 0;
+
+	    switch(tolower(text[q + 1]))
+	    {
+		case 'b': base = 2; break;
+		case 'o': base = 8; break;
+		case 'd': base = 10; break;
+		case 'h': base = 16; break;
+		default: error("bad literal " + text);
+	    }
+	    digits = text.substr(q + 2);
+	}
+
+	string clean;
+	BOOST_FOREACH(char c, digits)
+	    if(c != '_')
+		clean += c;
+
+	char *end;
+	e->m_value = strtoull(clean.c_str(), &end, base);
+
+	if(clean.empty() || *end || e->m_width > 64)
+	    error("unsupported literal " + text);
+
+	return e;
+    }
+
+    Expr *ident_expr( const string& name )
+    {
+	Expr *e = new Expr;
+	e->m_kind = Expr::IDENT;
+	e->m_name = name;
+	return e;
+    }
+
+    uint64_t const_value( Expr *e )
+    {
+	if(e->m_kind != Expr::NUMBER)
+	    error("constant expected");
+	return e->m_value;
+    }
+
+    int number_value()
+    {
+	return const_value(number());
+    }
+
+    void add_signal( const string& name, int width )
+    {
+	if(!m_mod->m_signals.count(name))
+	{
+	    m_mod->m_order.push_back(name);
+	    Signal& s = m_mod->m_signals[name];
+	    s.m_name = name;
+	    s.m_hasInit = false;
+	    s.m_init = NULL;
+	    s.m_width = width;
+	}
+
+	// "output x; reg [7:0] x;" - the ranged declaration wins
+	if(width > 1)
+	    m_mod->m_signals[name].m_width = width;
+    }
+
+    void check_signal( const string& name )
+    {
+	if(!m_mod->m_signals.count(name))
+	    error("undeclared signal " + name);
+    }
+
+    const Token& cur() const
+    {
+	return m_tok[m_pos];
+    }
+
+    const Token& next()
+    {
+	if(cur().m_kind == Token::END)
+	    error("unexpected end of file");
+	return m_tok[m_pos++];
+    }
+
+    bool peek( const char *text ) const
+    {
+	return cur().m_kind != Token::END && cur().m_text == text;
+    }
+
+    bool peek_at( int ahead, const char *text ) const
+    {
+	return m_pos + ahead < m_tok.size() && m_tok[m_pos + ahead].m_text == text;
+    }
+
+    bool accept( const char *text )
+    {
+	if(!peek(text))
+	    return false;
+	m_pos++;
+	return true;
+    }
+
+    void expect( const char *text )
+    {
+	if(!accept(text))
+	    error(string("'") + text + "' expected, got '" + cur().m_text + "'");
+    }
+
+    string ident()
+    {
+	if(cur().m_kind != Token::IDENT)
+	    error("identifier expected, got '" + cur().m_text + "'");
+	return next().m_text;
+    }
+
+    void error( const string& msg ) const
+    {
+	ostringstream os;
+	os << "line " << cur().m_line << ": " << msg;
+	throw runtime_error(os.str());
+    }
+
+    const vector<Token>& m_tok;
+    size_t m_pos;
+    Module *m_mod;
+};
+
+
+class Generator
+{
+public:
+    Generator( Module *m ) : m_mod( m ) {}
+
+    string generate( const string& source )
+    {
+	ostringstream os;
+	string name = m_mod->m_name;
+
+	os << "// generated by vlog2sim from " << source << ", do not edit\n\n";
+	os << "#ifndef __" << upper(name) << "_GEN_H\n";
+	os << "#define __" << upper(name) << "_GEN_H\n\n";
+	os << "#include \"sim.h\"\n\n";
+	os << "struct " << name << "\n{\n";
+
+	BOOST_FOREACH(const string& s, m_mod->m_order)
+	    os << "    Logic " << member(s) << ";\n";
+
+	os << "\n    " << name << "( Simulation *sim, const std::string prefix = \"\" )";
+
+	for(int i = 0; i < m_mod->m_order.size(); i++)
+	{
+	    const Signal& s = m_mod->m_signals[m_mod->m_order[i]];
+	    os << (i ? ",\n\t" : " :\n\t") << member(s.m_name) << "( " << s.m_width << ", prefix + \"" << s.m_name << "\" )";
+	}
+
+	os << "\n    {\n";
+
+	BOOST_FOREACH(const string& s, m_mod->m_order)
+	    os << "\tsim->add_signal( &" << member(s) << " );\n";
+
+	BOOST_FOREACH(const string& name, m_mod->m_order)
+	{
+	    const Signal& s = m_mod->m_signals[name];
+	    if(s.m_hasInit)
+		os << "\t" << member(name) << ".initial( LogicValue( " << s.m_width << ", "
+		   << expr(s.m_init, std::max(s.m_width, self_width(s.m_init))) << " ) );\n";
+	}
+
+	for(int i = 0; i < m_mod->m_processes.size(); i++)
+	{
+	    const Process& p = m_mod->m_processes[i];
+
+	    os << "\n";
+
+	    if(p.m_clocked)
+	    {
+		os << "\tsim->add_clocked_process( process_" << i << ", &" << member(p.m_clock)
+		   << ", prefix + \"" << proc_name(i) << "\", this );\n";
+	    } else {
+		set<string> reads, writes;
+		collect(p.m_body, reads, writes);
+
+		os << "\tstd::set<SigBase *> sens_" << i << ";\n";
+		BOOST_FOREACH(const string& s, reads)
+		    if(!writes.count(s))
+			os << "\tsens_" << i << ".insert( &" << member(s) << " );\n";
+
+		os << "\tsim->add_comb_process( process_" << i << ", sens_" << i
+		   << ", prefix + \"" << proc_name(i) << "\", this );\n";
+	    }
+	}
+
+	os << "    }\n";
+
+	for(int i = 0; i < m_mod->m_processes.size(); i++)
+	    process(os, i);
+
+	os << "};\n\n#endif\n";
+	return os.str();
+    }
+
+private:
+    void process( ostream& os, int n )
+    {
+	const Process& p = m_mod->m_processes[n];
+	set<string> reads, writes;
+
+	collect(p.m_body, reads, writes);
+
+	os << "\n    // " << proc_name(n) << "\n";
+	os << "    static int process_" << n << "( Context *c )\n    {\n";
+	os << "\t" << m_mod->m_name << " *m = static_cast<" << m_mod->m_name << " *>( c->m_arg );\n";
+
+	BOOST_FOREACH(const string& s, reads)
+	    os << "\tuint64_t r_" << s << " = m->" << member(s) << ".m_value;\n";
+	BOOST_FOREACH(const string& s, writes)
+	    if(!reads.count(s))
+		os << "\tuint64_t r_" << s << " = m->" << member(s) << ".m_value;\n";
+	BOOST_FOREACH(const string& s, writes)
+	    os << "\tuint64_t n_" << s << " = r_" << s << ";\n";
+
+	os << "\n";
+	statement(os, p.m_body, 1);
+	os << "\n";
+
+	BOOST_FOREACH(const string& s, writes)
+	    os << "\tc->assign( m->" << member(s) << ", LogicValue( " << width(s) << ", n_" << s << " ) );\n";
+
+	os << "\treturn 0;\n    }\n";
+    }
+
+    void statement( ostream& os, Stmt *s, int depth )
+    {
+	string ind(depth, '\t');
+
+	switch(s->m_kind)
+	{
+	    case Stmt::BLOCK:
+		BOOST_FOREACH(Stmt *b, s->m_body)
+		    statement(os, b, depth);
+		break;
+
+	    case Stmt::IF:
+		os << ind << "if( " << expr(s->m_cond, self_width(s->m_cond)) << " )\n" << ind << "{\n";
+		statement(os, s->m_body[0], depth + 1);
+		os << ind << "}\n";
+
+		if(s->m_body.size() > 1)
+		{
+		    os << ind << "else\n" << ind << "{\n";
+		    statement(os, s->m_body[1], depth + 1);
+		    os << ind << "}\n";
+		}
+		break;
+
+	    case Stmt::ASSIGN:
+	    {
+		Expr *lhs = s->m_lhs;
+		string name = lhs->m_name;
+		// non-blocking updates only become visible after the block
+		string base = s->m_blocking ? "r_" + name : "n_" + name;
+		string target = s->m_blocking ? "r_" + name + " = n_" + name : "n_" + name;
+		string value;
+
+		if(lhs->m_kind == Expr::IDENT)
+		{
+		    int w = width(name);
+		    value = fit(expr(s->m_rhs, std::max(w, self_width(s->m_rhs))), self_or(s->m_rhs, w), w);
+		} else if(lhs->m_kind == Expr::PART_SELECT) {
+		    int w = lhs->m_msb - lhs->m_lsb + 1;
+		    string v = fit(expr(s->m_rhs, std::max(w, self_width(s->m_rhs))), self_or(s->m_rhs, w), w);
+		    value = "(" + base + " & " + hex(~(mask(w) << lhs->m_lsb) & mask(width(name))) + ") | (" + v + " << " + str(lhs->m_lsb) + ")";
+		} else {
+		    string idx = expr(lhs->m_args[0], self_width(lhs->m_args[0]));
+		    string v = fit(expr(s->m_rhs, self_width(s->m_rhs)), self_width(s->m_rhs), 1);
+		    value = "(" + base + " & ~(1ULL << (" + idx + "))) | (" + v + " << (" + idx + "))";
+		}
+
+		os << ind << target << " = " << value << ";\n";
+		break;
+	    }
+	}
+    }
+
+    // C++ expression for e evaluated at width w (>= its self-determined width)
+    string expr( Expr *e, int w )
+    {
+	switch(e->m_kind)
+	{
+	    case Expr::NUMBER:
+		return hex(e->m_value & mask(w));
+
+	    case Expr::IDENT:
+		return "r_" + e->m_name;
+
+	    case Expr::BIT_SELECT:
+		if(e->m_args[0]->m_kind == Expr::NUMBER)
+		    return select(e->m_name, e->m_args[0]->m_value, 1);
+		return "((r_" + e->m_name + " >> (" + expr(e->m_args[0], self_width(e->m_args[0])) + ")) & 1)";
+
+	    case Expr::PART_SELECT:
+		return select(e->m_name, e->m_lsb, e->m_msb - e->m_lsb + 1);
+
+	    case Expr::CONCAT:
+	    {
+		string rv;
+		int shift = 0;
+
+		for(int i = e->m_args.size() - 1; i >= 0; i--)
+		{
+		    Expr *a = e->m_args[i];
+		    string v = expr(a, self_width(a));
+
+		    // zero padding needs no code
+		    if(a->m_kind != Expr::NUMBER || a->m_value)
+			rv = (rv.empty() ? "" : rv + " | ") + (shift ? "(" + v + " << " + str(shift) + ")" : v);
+		    shift += self_width(a);
+		}
+		return rv.empty() ? "0x0ULL" : "(" + rv + ")";
+	    }
+
+	    case Expr::REPLICATE:
+	    {
+		Expr *a = e->m_args[0];
+		int aw = self_width(a);
+		string v = expr(a, aw), rv;
+
+		for(int i = 0; i < e->m_value; i++)
+		    rv += (i ? " | " : "") + (i ? "(" + v + " << " + str(i * aw) + ")" : v);
+		return "(" + rv + ")";
+	    }
+
+	    case Expr::UNARY:
+	    {
+		Expr *a = e->m_args[0];
+		const string& op = e->m_op;
+
+		if(op == "~" || op == "-")
+		    return "((" + op + expr(a, w) + ") & " + hex(mask(w)) + ")";
+
+		int aw = self_width(a);
+		string v = expr(a, aw);
+
+		if(op == "!")
+		    return "(uint64_t) !" + v;
+		if(op == "&")
+		    return "(uint64_t) (" + v + " == " + hex(mask(aw)) + ")";
+		if(op == "|")
+		    return "(uint64_t) (" + v + " != 0)";
+		return "(uint64_t) __builtin_parityll(" + v + ")";
+	    }
+
+	    case Expr::BINARY:
+	    {
+		Expr *a = e->m_args[0], *b = e->m_args[1];
+		const string& op = e->m_op;
+
+		if(op == "&&" || op == "||")
+		    return "(uint64_t) (" + expr(a, self_width(a)) + " " + op + " " + expr(b, self_width(b)) + ")";
+
+		if(op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=")
+		{
+		    int cw = std::max(self_width(a), self_width(b));
+		    return "(uint64_t) (" + expr(a, cw) + " " + op + " " + expr(b, cw) + ")";
+		}
+
+		if(op == "<<" || op == ">>")
+		{
+		    string v = expr(a, w), n = expr(b, self_width(b));
+		    if(op == ">>")
+			return "(" + v + " >> " + n + ")";
+		    return "((" + v + " << " + n + ") & " + hex(mask(w)) + ")";
+		}
+
+		string v = "(" + expr(a, w) + " " + op + " " + expr(b, w) + ")";
+
+		// bitwise results can't exceed w, arithmetic ones can
+		if(op == "&" || op == "|" || op == "^" || w >= 64)
+		    return v;
+		return "(" + v + " & " + hex(mask(w)) + ")";
+	    }
+
+	    case Expr::TERNARY:
+		return "(" + expr(e->m_args[0], self_width(e->m_args[0])) + " ? " +
+		    expr(e->m_args[1], w) + " : " + expr(e->m_args[2], w) + ")";
+	}
+
+	return "";
+    }
+
+    // bits [lsb + w - 1:lsb] of a signal
+    string select( const string& name, int lsb, int w )
+    {
+	string v = lsb ? "(r_" + name + " >> " + str(lsb) + ")" : "r_" + name;
+
+	if(lsb + w >= width(name))
+	    return v;
+	return "(" + v + " & " + hex(mask(w)) + ")";
+    }
+
+    int self_width( Expr *e )
+    {
+	switch(e->m_kind)
+	{
+	    case Expr::NUMBER:
+		return e->m_width ? e->m_width : 32;
+	    case Expr::IDENT:
+		return width(e->m_name);
+	    case Expr::BIT_SELECT:
+		return 1;
+	    case Expr::PART_SELECT:
+		return e->m_msb - e->m_lsb + 1;
+	    case Expr::CONCAT:
+	    {
+		int w = 0;
+		BOOST_FOREACH(Expr *a, e->m_args)
+		    w += self_width(a);
+		if(w > 64)
+		    throw runtime_error("concatenations wider than 64 bits are not supported");
+		return w;
+	    }
+	    case Expr::REPLICATE:
+		return e->m_value * self_width(e->m_args[0]);
+	    case Expr::UNARY:
+		return (e->m_op == "~" || e->m_op == "-") ? self_width(e->m_args[0]) : 1;
+	    case Expr::BINARY:
+	    {
+		const string& op = e->m_op;
+		if(op == "&&" || op == "||" || op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=")
+		    return 1;
+		if(op == "<<" || op == ">>")
+		    return self_width(e->m_args[0]);
+		return std::max(self_width(e->m_args[0]), self_width(e->m_args[1]));
+	    }
+	    case Expr::TERNARY:
+		return std::max(self_width(e->m_args[1]), self_width(e->m_args[2]));
+	}
+	return 1;
+    }
+
+    int self_or( Expr *e, int w )
+    {
+	return std::max(self_width(e), w);
+    }
+
+    // truncates a value computed at width from to width to
+    string fit( const string& v, int from, int to )
+    {
+	if(from <= to)
+	    return v;
+	return "(" + v + " & " + hex(mask(to)) + ")";
+    }
+
+    void collect( Stmt *s, set<string>& reads, set<string>& writes )
+    {
+	switch(s->m_kind)
+	{
+	    case Stmt::BLOCK:
+	    case Stmt::IF:
+		if(s->m_kind == Stmt::IF)
+		    collect(s->m_cond, reads);
+		BOOST_FOREACH(Stmt *b, s->m_body)
+		    collect(b, reads, writes);
+		break;
+
+	    case Stmt::ASSIGN:
+		writes.insert(s->m_lhs->m_name);
+		if(s->m_lhs->m_kind == Expr::BIT_SELECT)
+		    collect(s->m_lhs->m_args[0], reads);
+		collect(s->m_rhs, reads);
+		break;
+	}
+    }
+
+    void collect( Expr *e, set<string>& reads )
+    {
+	if(e->m_kind == Expr::IDENT || e->m_kind == Expr::BIT_SELECT || e->m_kind == Expr::PART_SELECT)
+	    reads.insert(e->m_name);
+
+	BOOST_FOREACH(Expr *a, e->m_args)
+	    collect(a, reads);
+    }
+
+    int width( const string& name )
+    {
+	return m_mod->m_signals[name].m_width;
+    }
+
+    string proc_name( int n )
+    {
+	const Process& p = m_mod->m_processes[n];
+
+	if(p.m_clocked)
+	    return "always_" + str(n);
+	if(p.m_body->m_kind == Stmt::ASSIGN)
+	    return "assign_" + p.m_body->m_lhs->m_name;
+	return "comb_" + str(n);
+    }
+
+    string member( const string& name )
+    {
+	static const char *reserved[] = { "and", "bool", "case", "char", "class", "const", "default", "delete",
+					  "do", "double", "float", "for", "int", "long", "new", "not", "or",
+					  "private", "public", "return", "short", "signed", "static", "struct",
+					  "switch", "this", "unsigned", "void", "while", "xor", "m", "c", NULL };
+
+	for(int i = 0; reserved[i]; i++)
+	    if(name == reserved[i])
+		return name + "_";
+	return name;
+    }
+
+    static uint64_t mask( int w )
+    {
+	return w >= 64 ? ~0ULL : (1ULL << w) - 1;
+    }
+
+    static string hex( uint64_t v )
+    {
+	char buf[32];
+	sprintf(buf, "0x%llxULL", (unsigned long long) v);
+	return buf;
+    }
+
+    static string str( int v )
+    {
+	ostringstream os;
+	os << v;
+	return os.str();
+    }
+
+    static string upper( const string& s )
+    {
+	string rv;
+	BOOST_FOREACH(char c, s)
+	    rv += toupper(c);
+	return rv;
+    }
+
+    Module *m_mod;
+};
+
+
+int main(int argc, char *argv[])
+{
+    if(argc != 3)
+    {
+	fprintf(stderr, "usage: %s input.v output.h\n", argv[0]);
+	return 1;
+    }
+
+    FILE *f = fopen(argv[1], "r");
+    if(!f)
+    {
+	fprintf(stderr, "%s: can't open %s\n", argv[0], argv[1]);
+	return 1;
+    }
+
+    string src;
+    char buf[4096];
+    size_t n;
+
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+	src.append(buf, n);
+    fclose(f);
+
+    try {
+	Lexer lexer(src);
+	vector<Token> tokens = lexer.tokenize();
+	Parser parser(tokens);
+	Module *m = parser.parse_module();
+	Generator gen(m);
+	string out = gen.generate(argv[1]);
+
+	f = fopen(argv[2], "w");
+	if(!f)
+	{
+	    fprintf(stderr, "%s: can't write %s\n", argv[0], argv[2]);
+	    return 1;
+	}
+
+	fputs(out.c_str(), f);
+	fclose(f);
+    } catch(const exception& e) {
+	fprintf(stderr, "%s: %s: %s\n", argv[0], argv[1], e.what());
+	return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,268 @@
+#include "wavecmp.h"
+
+std::string WaveMismatch::describe() const
+{
+    char buf[256];
+    std::string exp, act;
+
+    // binary, with the unknown bits as x
+    for(int i = m_bits - 1; i >= 0; i--)
+    {
+	uint64_t bit = 1ULL << i;
+
+	exp += (m_unknown & bit) ? 'x' : (m_expected & bit) ? '1' : '0';
+	act += (m_actual & bit) ? '1' : '0';
+    }
+
+    snprintf(buf, sizeof(buf), "%s at %lld: expected %s (0x%llx), got %s (0x%llx)", m_name.c_str(), (long long) m_time,
+	     exp.c_str(), (unsigned long long) m_expected, act.c_str(), (unsigned long long) m_actual);
+    return buf;
+}
+
+WaveCompare::WaveCompare( Simulation *sim, const std::string golden ) :
+    m_sim( sim ), m_hasNext( false ), m_first( true ), m_failed( false )
+{
+    if(!m_golden.open(golden))
+    {
+	m_error = m_golden.m_error;
+	return;
+    }
+
+    m_codes.resize( m_golden.n_codes() );
+    for(int i = 0; i < m_codes.size(); i++)
+    {
+	m_codes[i].m_expected = m_codes[i].m_unknown = 0;
+	m_codes[i].m_dirty = false;
+    }
+
+    std::map<std::string, Logic *> signals;
+
+    BOOST_FOREACH(SigBase *s, m_sim->m_signals)
+	if( Logic *l = dynamic_cast<Logic *>(s) )
+	    signals[l->name()] = l;
+
+    BOOST_FOREACH(const VCDReader::Var& v, m_golden.m_vars)
+    {
+	std::map<std::string, Logic *>::iterator i = signals.find(v.m_name);
+
+	if(i == signals.end())
+	    m_unmatched.push_back( v.m_name + ": no such signal" );
+	else if(i->second->m_bits != v.m_bits)
+	    m_unmatched.push_back( v.m_name + ": width differs" );
+	else if(!m_signalCodes.count(i->second)) {
+	    m_codes[v.m_code].m_signals.push_back(i->second);
+	    m_signalCodes[i->second] = v.m_code;
+	    m_sim->add_value_callback( i->second, on_change, this );
+	}
+    }
+
+    m_hasNext = m_golden.next(m_next);
+    m_sim->m_compare = this;
+}
+
+WaveCompare::~WaveCompare()
+{
+    for(std::map<const SigBase *, int>::iterator i = m_signalCodes.begin(); i != m_signalCodes.end(); ++i)
+	m_sim->remove_value_callback( const_cast<SigBase *>(i->first), on_change, this );
+
+    if(m_sim->m_compare == this)
+	m_sim->m_compare = NULL;
+}
+
+void WaveCompare::mark( int code )
+{
+    if(!m_codes[code].m_dirty)
+    {
+	m_codes[code].m_dirty = true;
+	m_dirty.push_back(code);
+    }
+}
+
+void WaveCompare::on_change( const ValueChange& vc, void *arg )
+{
+    WaveCompare *w = static_cast<WaveCompare *>( arg );
+
+    w->mark( w->m_signalCodes[vc.m_sig] );
+}
+
+bool WaveCompare::check()
+{
+    if(m_failed)
+	return false;
+
+    while(m_hasNext && m_next.m_time <= m_sim->m_time)
+    {
+	if(m_next.m_code >= 0)
+	{
+	    Code& c = m_codes[m_next.m_code];
+
+	    c.m_expected = m_next.m_value;
+	    c.m_unknown = m_next.m_unknown;
+	    if(!c.m_signals.empty())
+		mark(m_next.m_code);
+	}
+
+	m_hasNext = m_golden.next(m_next);
+    }
+
+    if(m_first)
+    {
+	for(int i = 0; i < m_codes.size(); i++)
+	    if(!m_codes[i].m_signals.empty())
+		mark(i);
+	m_first = false;
+    }
+
+    BOOST_FOREACH(int i, m_dirty)
+    {
+	Code& c = m_codes[i];
+
+	c.m_dirty = false;
+
+	// report the first mismatch, the rest only clear their flags
+	if(m_failed)
+	    continue;
+
+	BOOST_FOREACH(Logic *l, c.m_signals)
+	{
+	    if( ( (l->value() ^ c.m_expected) & ~c.m_unknown & l->mask() ) == 0 )
+		continue;
+
+	    m_mismatch.m_name = l->name();
+	    m_mismatch.m_time = m_sim->m_time;
+	    m_mismatch.m_bits = l->m_bits;
+	    m_mismatch.m_expected = c.m_expected & l->mask();
+	    m_mismatch.m_actual = l->value();
+	    m_mismatch.m_unknown = c.m_unknown & l->mask();
+	    m_failed = true;
+	    break;
+	}
+    }
+
+    m_dirty.clear();
+
+    if(m_failed)
+    {
+	fprintf(stderr, "golden mismatch: %s\n", m_mismatch.describe().c_str());
+	m_sim->stop();
+    }
+
+    return !m_failed;
+}
+
+
+/*
+ Two readers advance together, one timestamp at a time. Variables are
+ paired by name; a pair is compared when either side changed it.
+*/
+
+bool compare_vcd( const std::string a, const std::string b, WaveMismatch& mismatch, std::string& error )
+{
+    VCDReader ra, rb;
+
+    mismatch.m_name.clear();
+
+    if(!ra.open(a))
+    {
+	error = a + ": " + ra.m_error;
+	return false;
+    }
+    if(!rb.open(b))
+    {
+	error = b + ": " + rb.m_error;
+	return false;
+    }
+
+    struct Pair
+    {
+	std::string m_name;
+	int m_bits, m_a, m_b;
+    };
+
+    std::vector<Pair> pairs;
+    std::vector< std::vector<int> > pairs_a( ra.n_codes() ), pairs_b( rb.n_codes() );
+
+    BOOST_FOREACH(const VCDReader::Var& v, ra.m_vars)
+    {
+	int code = rb.find(v.m_name);
+
+	if(code < 0)
+	    continue;
+
+	Pair p = { v.m_name, std::min(v.m_bits, 64), v.m_code, code };
+	pairs_a[v.m_code].push_back( pairs.size() );
+	pairs_b[code].push_back( pairs.size() );
+	pairs.push_back(p);
+    }
+
+    std::vector<uint64_t> val_a( ra.n_codes() ), unk_a( ra.n_codes() ), val_b( rb.n_codes() ), unk_b( rb.n_codes() );
+    std::vector<bool> dirty( pairs.size() );
+    std::vector<int> changed;
+
+    VCDReader::Change ca, cb;
+    bool has_a = ra.next(ca), has_b = rb.next(cb);
+
+    while(has_a || has_b)
+    {
+	int64_t t = !has_b || (has_a && ca.m_time < cb.m_time) ? ca.m_time : cb.m_time;
+
+	for(; has_a && ca.m_time == t; has_a = ra.next(ca))
+	{
+	    if(ca.m_code < 0)
+		continue;
+
+	    val_a[ca.m_code] = ca.m_value;
+	    unk_a[ca.m_code] = ca.m_unknown;
+	    BOOST_FOREACH(int p, pairs_a[ca.m_code])
+		if(!dirty[p])
+		{
+		    dirty[p] = true;
+		    changed.push_back(p);
+		}
+	}
+
+	for(; has_b && cb.m_time == t; has_b = rb.next(cb))
+	{
+	    if(cb.m_code < 0)
+		continue;
+
+	    val_b[cb.m_code] = cb.m_value;
+	    unk_b[cb.m_code] = cb.m_unknown;
+	    BOOST_FOREACH(int p, pairs_b[cb.m_code])
+		if(!dirty[p])
+		{
+		    dirty[p] = true;
+		    changed.push_back(p);
+		}
+	}
+
+	BOOST_FOREACH(int i, changed)
+	{
+	    const Pair& p = pairs[i];
+	    uint64_t mask = p.m_bits == 64 ? ~0ULL : (1ULL << p.m_bits) - 1;
+
+	    dirty[i] = false;
+
+	    if( ( (val_a[p.m_a] ^ val_b[p.m_b]) | (unk_a[p.m_a] ^ unk_b[p.m_b]) ) & mask )
+	    {
+		mismatch.m_name = p.m_name;
+		mismatch.m_time = t;
+		mismatch.m_bits = p.m_bits;
+		mismatch.m_expected = val_a[p.m_a] & mask;
+		mismatch.m_actual = val_b[p.m_b] & mask;
+		mismatch.m_unknown = (unk_a[p.m_a] | unk_b[p.m_b]) & mask;
+		return false;
+	    }
+	}
+
+	changed.clear();
+    }
+
+    if(!ra.m_error.empty() || !rb.m_error.empty())
+    {
+	error = !ra.m_error.empty() ? a + ": " + ra.m_error : b + ": " + rb.m_error;
+	return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifndef __WAVECMP_H
+#define __WAVECMP_H
+
+#include "sim.h"
+#include "vcdreader.h"
+
+/*
+ Regression checking against golden waveforms.
+
+ WaveCompare streams a golden VCD alongside the run. Golden variables are
+ matched to Logic signals by name when it is created. At every point where
+ VCDWriter would dump (see Simulation::dump()), it applies the golden
+ changes up to the current time and compares only the variables that changed
+ on either side: value change callbacks flag the simulation side. x/z bits
+ of the golden are don't-cares. The first mismatch is reported and stops the
+ simulation.
+
+ compare_vcd() compares two dump files the same way, streaming both in
+ parallel with per-variable state only.
+*/
+
+struct WaveMismatch
+{
+    std::string m_name;
+    int64_t m_time;
+    int m_bits;
+    uint64_t m_expected, m_actual;
+    // bits that were x/z in the expected (or actual, for file compares) value
+    uint64_t m_unknown;
+
+    // "name at time: expected ..., got ..."
+    std::string describe() const;
+};
+
+class WaveCompare
+{
+public:
+    WaveCompare( Simulation *sim, const std::string golden );
+    virtual ~WaveCompare();
+
+    bool ok() const
+    {
+	return m_error.empty();
+    }
+
+    /**
+     * Function check()
+     * Called by the kernel at every dump point. Returns false (and stops the
+     * simulation) at the first mismatch. Virtual, so that the kernel can call
+     * it without linking the comparator into every binary.
+     */
+    virtual bool check();
+
+    bool failed() const
+    {
+	return m_failed;
+    }
+
+    WaveMismatch m_mismatch;
+    // golden variables that could not be matched, with the reason
+    std::vector<std::string> m_unmatched;
+    std::string m_error;
+
+private:
+    struct Code
+    {
+	uint64_t m_expected, m_unknown;
+	bool m_dirty;
+	std::vector<Logic *> m_signals;
+    };
+
+    static void on_change( const ValueChange& vc, void *arg );
+    void mark( int code );
+
+    Simulation *m_sim;
+    VCDReader m_golden;
+    VCDReader::Change m_next;
+    bool m_hasNext, m_first, m_failed;
+
+    std::vector<Code> m_codes;
+    std::vector<int> m_dirty;
+    // code per compared signal, for the change callbacks
+    std::map<const SigBase *, int> m_signalCodes;
+};
+
+/**
+ * Function compare_vcd()
+ * Streams the dumps a and b in parallel and compares the variables they have
+ * in common at every timestamp. Returns true if they match; otherwise
+ * mismatch holds the first difference (empty name if a file could not be
+ * read, with the reason in error).
+ */
+bool compare_vcd( const std::string a, const std::string b, WaveMismatch& mismatch, std::string& error );
+
+#endif